@@ -0,0 +1,75 @@
+/*
+ * Tag match microbenchmark,
+ * lookups per second of every tag matching kernel at 4/8/16/32 ways
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "tag_match.hpp"
+
+namespace {
+
+    const int NUM_SETS = 4096;
+    const int NUM_PROBES = 1 << 16;
+    const int ROUNDS = 64;
+
+    struct Kernel {
+        const char *name;
+        cs::tag_match_fn fn;
+    };
+
+    double run(cs::tag_match_fn fn, const std::vector<uint64_t>& tags, int ways,
+               const std::vector<uint32_t>& sets, const std::vector<uint64_t>& probes, long& checksum) {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int i = 0; i < NUM_PROBES; i++)
+                checksum += fn(tags.data() + static_cast<size_t>(sets[i]) * ways, ways, probes[i]);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(ROUNDS) * NUM_PROBES / elapsed.count();
+    }
+}
+
+int main() {
+    std::vector<Kernel> kernels = {
+            {"scalar", cs::match_tag_scalar},
+#if defined(__x86_64__) || defined(__i386__)
+            {"sse2", cs::match_tag_sse2},
+#endif
+    };
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", cs::match_tag_avx2});
+#endif
+
+    std::printf("dispatched kernel: %s\n\n", cs::match_tag_name());
+    std::printf("%-6s %-8s %16s\n", "ways", "kernel", "lookups/s");
+
+    std::mt19937_64 rng(42);
+    for (int ways : {4, 8, 16, 32}) {
+        std::vector<uint64_t> tags(static_cast<size_t>(NUM_SETS) * ways);
+        for (auto& tag : tags)
+            tag = rng() >> 16;
+
+        /* half the probes hit a random way, the other half miss */
+        std::vector<uint32_t> sets(NUM_PROBES);
+        std::vector<uint64_t> probes(NUM_PROBES);
+        for (int i = 0; i < NUM_PROBES; i++) {
+            sets[i] = static_cast<uint32_t>(rng() % NUM_SETS);
+            if (i % 2 == 0)
+                probes[i] = tags[static_cast<size_t>(sets[i]) * ways + rng() % ways];
+            else
+                probes[i] = (rng() >> 16) | (uint64_t(1) << 60);
+        }
+
+        for (auto& kernel : kernels) {
+            long checksum = 0;
+            double rate = run(kernel.fn, tags, ways, sets, probes, checksum);
+            std::printf("%-6d %-8s %16.0f   (checksum %ld)\n", ways, kernel.name, rate, checksum);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Throughput benchmark,
+ * ns/reference and references/s of address translation, cache lookup and victim selection
+ * at 2-32 ways, and of the whole driver under configs 1-3 on generated and given traces
+ *
+ * usage: bench-throughput [--min-rate refs/s] [trace ...]
+ * with --min-rate it fails if the driver runs any trace slower than that
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "address_translator.hpp"
+#include "cache.hpp"
+#include "driver.hpp"
+#include "generator.hpp"
+#include "trace_source.hpp"
+
+namespace {
+
+    using cs::Reference;
+
+    const double MIN_TIME = 0.25; /* seconds each measurement runs for at least */
+    const size_t SYNTHETIC = 1 << 20; /* references per synthetic run */
+
+    volatile long checksum; /* keeps results the compiler could otherwise drop */
+
+    struct Trace {
+        std::string name;
+        std::vector<Reference> refs;
+    };
+
+    /*
+     * runs pass() until MIN_TIME is up, returns the seconds one reference took,
+     * pass() runs `refs' references
+     */
+    template <typename Pass>
+    double measure(size_t refs, Pass pass) {
+        pass(); /* warm up */
+        size_t passes = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed(0);
+        do {
+            pass();
+            passes++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < MIN_TIME);
+        return elapsed.count() / (static_cast<double>(passes) * static_cast<double>(refs));
+    }
+
+    void report(const std::string& benchmark, const std::string& trace, double seconds) {
+        std::printf("%-28s %-16s %10.2f %16.0f\n", benchmark.c_str(), trace.c_str(), seconds * 1e9, 1.0 / seconds);
+    }
+
+    /*
+     * a generated trace, see generator.hpp
+     */
+    Trace generated(const std::string& spec) {
+        cs::DecodedTrace decoded(cs::Generator::create(spec));
+        return Trace{spec.substr(0, spec.find(':')), std::vector<Reference>(decoded.data(), decoded.data() + decoded.size())};
+    }
+
+    void translate(std::mt19937_64& rng) {
+        cs::AddressTranslator at(32 << 10, 32, 64, 128, 4);
+        std::vector<uint64_t> addresses(SYNTHETIC);
+        for (auto& address : addresses)
+            address = rng() & 0xffffffff;
+        double seconds = measure(addresses.size(), [&]() {
+            long sum = 0;
+            for (auto address : addresses)
+                sum += at.translate(address).set;
+            checksum = checksum + sum;
+        });
+        report("translate", "uniform", seconds);
+    }
+
+    /*
+     * a single 64-set cache of 64-byte blocks at every associativity,
+     * lookup re-reads blocks it holds, victim streams through new blocks so every reference evicts one
+     */
+    void cache_ops() {
+        for (int ways : {2, 4, 8, 16, 32}) {
+            const int sets = 64;
+            size_t blocks = static_cast<size_t>(sets) * ways;
+            std::vector<Reference> hits(SYNTHETIC), misses(SYNTHETIC);
+            for (size_t i = 0; i < SYNTHETIC; i++) {
+                hits[i] = Reference{(i % blocks) * 64, cs::DATA_READ, 0};
+                misses[i] = Reference{i * 64, cs::DATA_READ, 0};
+            }
+            std::vector<uint32_t> idx(SYNTHETIC), missed(SYNTHETIC);
+            std::iota(idx.begin(), idx.end(), 0);
+
+            for (const char *policy : {"lru", "plru", "srrip", "random", "fifo", "lfu"}) {
+                cs::WriteBack cache(blocks * 64, 64, 32, ways, 1, 100, nullptr, policy);
+                if (std::strcmp(policy, "lru") == 0) {
+                    double seconds = measure(SYNTHETIC, [&]() {
+                        (void) cache.exec_batch(hits.data(), idx.data(), SYNTHETIC, missed.data());
+                    });
+                    report("lookup " + std::to_string(ways) + "-way", "resident", seconds);
+                }
+                double seconds = measure(SYNTHETIC, [&]() {
+                    (void) cache.exec_batch(misses.data(), idx.data(), SYNTHETIC, missed.data());
+                });
+                report("victim " + std::to_string(ways) + "-way " + policy, "streaming", seconds);
+            }
+        }
+    }
+
+    std::vector<cs::config> preset(int config) {
+        switch (config) {
+            case 1:
+                return {{cs::write_through, cs::write_through, 1024, 32, 32, 1, 100, 4, "lru", cs::nine, false}};
+            case 2:
+                return {{cs::write_back, cs::write_back, 1024, 32, 32, 1, 100, 4, "lru", cs::nine, false}};
+            default:
+                return {{cs::write_back, cs::write_back, 1024, 32, 32, 1, 100, 2, "lru", cs::nine, false},
+                        {0, cs::write_back, 16384, 128, 32, 1, 100, 4, "lru", cs::nine, false}};
+        }
+    }
+
+    /*
+     * CacheDriver::exec over a whole trace, returns the slowest rate
+     */
+    double driver(const std::vector<Trace>& traces) {
+        double slowest = 0;
+        for (auto& trace : traces) {
+            for (int config = 1; config <= 3; config++) {
+                std::vector<cs::config> configs = preset(config);
+                cs::CacheDriver cache(configs);
+                double seconds = measure(trace.refs.size(), [&]() {
+                    (void) cache.exec(trace.refs.data(), trace.refs.size());
+                });
+                report("driver config " + std::to_string(config), trace.name, seconds);
+                if (seconds > slowest)
+                    slowest = seconds;
+            }
+        }
+        return 1.0 / slowest;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    double min_rate = 0;
+    std::mt19937_64 rng(42);
+    std::vector<Trace> traces;
+
+    try {
+        traces.push_back(generated("mixed:n=1M:writes=0.2"));
+        traces.push_back(generated("zipf:n=1M:size=1M"));
+        traces.push_back(generated("uniform:n=1M"));
+
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], "--min-rate") == 0 && i + 1 < argc) {
+                min_rate = std::strtod(argv[++i], nullptr);
+                continue;
+            }
+            /* a sample trace, decoded up front so only the simulation is timed */
+            cs::DecodedTrace decoded(argv[i]);
+            std::string name = argv[i];
+            name = name.substr(name.find_last_of('/') + 1);
+            traces.push_back(Trace{name, std::vector<Reference>(decoded.data(), decoded.data() + decoded.size())});
+        }
+
+        std::printf("%-28s %-16s %10s %16s\n", "benchmark", "trace", "ns/ref", "refs/s");
+        translate(rng);
+        cache_ops();
+        double rate = driver(traces);
+
+        if (min_rate > 0 && rate < min_rate) {
+            std::printf("\nFAILED: slowest driver run %.0f refs/s, below %.0f refs/s\n", rate, min_rate);
+            return 1;
+        }
+    } catch (std::exception& ex) {
+        std::fprintf(stderr, "%s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,6 @@
 /*
  * Address translator,
- * convert hex to binary and extract tag, index and offset bits
+ * parse hex addresses and extract tag, index and offset bits
  * 
  * Author: Parsa Bagheri
  */
@@ -8,59 +8,91 @@
 #ifndef CACHE_SIM_ADDRESS_TRANSLATOR_HPP
 #define CACHE_SIM_ADDRESS_TRANSLATOR_HPP
 
+#include <cstdint>
 #include "errors.hpp"
 
 namespace cs {
 
 /*
- * struct containing tag, set, and offset of an address
+ * struct containing tag, set, and offset of an address,
+ * tags take up to 64 bits, sets are bounded by AddressTranslator::MAX_SETS
  */
     struct Addr {
-        const int tag, set, offset;
-        Addr(int tag, int set, int offset): tag(tag), set(set), offset(offset) {}
+        const uint64_t tag;
+        const int set;
+        const uint64_t offset;
+        Addr(uint64_t tag, int set, uint64_t offset): tag(tag), set(set), offset(offset) {}
     };
 
     class AddressTranslator {
 
         /* constructor parameters */
-        int cache_size;
+        uint64_t cache_size;
         int address_size;
-        int block_size;
+        uint64_t block_size;
         int num_sets;
         int blocks_per_set;
-        bool debug;
 
         int num_tag_bits;
         int num_index_bits;
         int num_offset_bits;
 
+        /* precomputed masks, applied after shifting the field down */
+        uint64_t tag_mask;
+        uint64_t index_mask;
+        uint64_t offset_mask;
+
     public:
+        static const int MAX_SETS = 0x7fffffff; /* set indices are ints */
+
     /*
      * Constructor for AddressTranslator object
      * throws AddressTranslation exception when inconsistent arguments are passed
      */
-        AddressTranslator(int cache_size, unsigned int address_size, int block_size,
-                          int num_sets, int blocks_per_set, bool debug = false);
+        AddressTranslator(uint64_t cache_size, unsigned int address_size, uint64_t block_size,
+                          int num_sets, int blocks_per_set);
 
     /*
-     * the only public method of AddressTranslator
      * takes a hex string address and returns an Addr object
      */
         Addr translate (const char *address);
 
-    private:
     /*
-     * convert a hex string to a binary string
-     *
-     * bit_array is an empty array passed as an argument, which will be filled
-     * hex_address is the hex string that we want to convert.
+     * takes an already parsed address and returns an Addr object
+     * throws AddressTranslation if the address is wider than address_size
+     */
+        Addr translate (uint64_t address);
+
+    /*
+     * translate without the width check,
+     * for addresses the caller has already validated
+     */
+        Addr decode (uint64_t address) const {
+            return Addr((address >> (num_offset_bits + num_index_bits)) & tag_mask,
+                        static_cast<int>((address >> num_offset_bits) & index_mask),
+                        address & offset_mask);
+        }
+
+    /*
+     * first address of the block with the given tag and set, the inverse of decode
+     */
+        uint64_t block_address (uint64_t tag, uint64_t set) const {
+            unsigned shift = num_offset_bits + num_index_bits;
+            return (shift >= 64 ? 0 : tag << shift) | (set << num_offset_bits);
+        }
+
+    /*
+     * true if address fits in address_size bits
      */
-        void get_bit_array(char *bit_array, const char *hex_address);
+        bool valid (uint64_t address) const {
+            return address_size >= 64 || (address >> address_size) == 0;
+        }
 
     /*
-     * converts binary to decimal
+     * parses a hex string address (optionally prefixed with 0x or 0X)
+     * throws AddressTranslation on invalid digits or if it has more digits than address_size allows
      */
-        int bin_to_int(char *binary);
+        uint64_t parse (const char *address);
     };
 
 }
@@ -0,0 +1,214 @@
+/*
+ * Belady's MIN definition
+ */
+
+#include "belady.hpp"
+#include <numeric>
+#include <utility>
+
+namespace cs {
+
+    namespace {
+
+        /*
+         * a max-heap per set of its filled ways keyed on their next use,
+         * laid out flat like the tag store, set `set' owns [set * ways, set * ways + ways)
+         */
+        class NextUseHeaps {
+            int _ways;
+            std::vector<uint64_t> _key; /* by line */
+            std::vector<int> _heap; /* by heap slot, the way in it */
+            std::vector<int> _slot; /* by line, its heap slot */
+            std::vector<int> _size; /* by set, ways filled */
+
+            void swap(size_t base, int a, int b) {
+                std::swap(_heap[base + a], _heap[base + b]);
+                _slot[base + _heap[base + a]] = a;
+                _slot[base + _heap[base + b]] = b;
+            }
+
+            uint64_t key(size_t base, int slot) const { return _key[base + _heap[base + slot]]; }
+
+            void up(size_t base, int slot) {
+                while (slot > 0) {
+                    int parent = (slot - 1) / 2;
+                    if (key(base, parent) >= key(base, slot))
+                        return;
+                    swap(base, parent, slot);
+                    slot = parent;
+                }
+            }
+
+            void down(size_t base, int size, int slot) {
+                while (true) {
+                    int largest = slot, left = 2 * slot + 1, right = left + 1;
+                    if (left < size && key(base, left) > key(base, largest))
+                        largest = left;
+                    if (right < size && key(base, right) > key(base, largest))
+                        largest = right;
+                    if (largest == slot)
+                        return;
+                    swap(base, slot, largest);
+                    slot = largest;
+                }
+            }
+
+        public:
+            NextUseHeaps(int num_sets, int ways)
+                    : _ways(ways), _key(static_cast<size_t>(num_sets) * ways), _heap(_key.size()),
+                      _slot(_key.size()), _size(num_sets, 0) {}
+
+            int size(int set) const { return _size[set]; }
+
+            /* the next way of set, filled with a line next used at key */
+            int fill(int set, uint64_t key) {
+                size_t base = static_cast<size_t>(set) * _ways;
+                int way = _size[set]++;
+                _key[base + way] = key;
+                _heap[base + way] = way;
+                _slot[base + way] = way;
+                up(base, way);
+                return way;
+            }
+
+            /* the way used again farthest in the future */
+            int farthest(int set) const { return _heap[static_cast<size_t>(set) * _ways]; }
+
+            void rekey(int set, int way, uint64_t key) {
+                size_t base = static_cast<size_t>(set) * _ways;
+                uint64_t old = _key[base + way];
+                _key[base + way] = key;
+                if (key > old)
+                    up(base, _slot[base + way]);
+                else
+                    down(base, _size[set], _slot[base + way]);
+            }
+        };
+    }
+
+    Belady::Belady(size_t block_size, int num_sets, int ways, unsigned address_size,
+                   const std::vector<std::string>& policies, size_t memory)
+            : _block_size(block_size), _num_sets(num_sets), _ways(ways),
+              _trace(memory / 2), _next(memory / 2), _hits(0), _misses(0), _policy_names(policies) {
+        if (ways <= 0)
+            throw CSException("invalid associativity");
+        _at = new AddressTranslator(static_cast<uint64_t>(block_size) * num_sets * ways, address_size,
+                                    block_size, num_sets, ways);
+        try {
+            for (auto& policy : policies)
+                _policies.emplace_back(new WriteBack(block_size * num_sets * ways, block_size, address_size,
+                                                     ways, 1, 100, nullptr, policy));
+        } catch (...) {
+            delete _at;
+            throw;
+        }
+    }
+
+    Belady::~Belady() {
+        delete _at;
+    }
+
+    void Belady::access(uint64_t address) {
+        Addr addr = _at->translate(address);
+        uint64_t block = address / _block_size;
+        auto it = _ids.emplace(block, static_cast<uint32_t>(_blocks.size()));
+        if (it.second) {
+            if (_blocks.size() == UINT32_MAX)
+                throw CSException("too many distinct blocks for MIN, at most 2^32 - 1");
+            _blocks.push_back(block * _block_size);
+            _sets.push_back(static_cast<uint32_t>(addr.set));
+        }
+        _trace.push_back(it.first->second);
+    }
+
+    void Belady::backward() {
+        size_t n = _trace.size();
+        _next.resize(n);
+        std::vector<uint64_t> last(_blocks.size(), UINT64_MAX);
+        for (size_t i = n; i-- > 0; ) {
+            uint32_t id = _trace[i];
+            uint64_t at = last[id];
+            _next[i] = at == UINT64_MAX || at - i >= NEVER ? NEVER : static_cast<uint32_t>(at - i);
+            last[id] = i;
+        }
+    }
+
+    void Belady::forward() {
+        NextUseHeaps heaps(_num_sets, _ways);
+        std::vector<uint32_t> lines(static_cast<size_t>(_num_sets) * _ways); /* by line, the block id in it */
+        std::vector<int32_t> way_of(_blocks.size(), -1); /* by block id, its way while it's cached */
+
+        std::vector<Reference> batch(BATCH);
+        std::vector<uint32_t> idx(BATCH), missed(BATCH);
+        std::iota(idx.begin(), idx.end(), 0);
+        size_t batched = 0;
+
+        size_t n = _trace.size();
+        for (size_t i = 0; i < n; i++) {
+            uint32_t id = _trace[i];
+            uint64_t key = _next[i] == NEVER ? UINT64_MAX : i + _next[i];
+            int set = static_cast<int>(_sets[id]);
+            int way = way_of[id];
+
+            if (way >= 0) {
+                _hits++;
+                heaps.rekey(set, way, key);
+            } else {
+                _misses++;
+                if (heaps.size(set) < _ways) {
+                    way = heaps.fill(set, key);
+                } else {
+                    way = heaps.farthest(set);
+                    way_of[lines[static_cast<size_t>(set) * _ways + way]] = -1;
+                    heaps.rekey(set, way, key);
+                }
+                lines[static_cast<size_t>(set) * _ways + way] = id;
+                way_of[id] = way;
+            }
+
+            if (_policies.empty())
+                continue;
+            batch[batched++] = Reference{_blocks[id], DATA_READ, 0};
+            if (batched == BATCH || i + 1 == n) {
+                for (auto& policy : _policies)
+                    (void) policy->exec_batch(batch.data(), idx.data(), batched, missed.data());
+                batched = 0;
+            }
+        }
+    }
+
+    void Belady::run() {
+        backward();
+        forward();
+    }
+
+    void Belady::summary(std::ostream& out) const {
+        uint64_t refs = references();
+        out << "Belady MIN summary:\n";
+        out << "  number of sets: " << _num_sets << "\n";
+        out << "  associativity: " << _ways << "\n";
+        out << "  block size: " << _block_size << "B\n";
+        out << "  number of memory accesses: " << refs << "\n";
+        out << "  compulsory misses: " << compulsory_misses() << "\n";
+        if (_trace.spilled())
+            out << "  trace spilled to disk past the memory budget\n";
+        out << "\n";
+
+        auto row = [&](const std::string& name, uint64_t hits, uint64_t misses) {
+            double hit_rate = refs == 0 ? 0.0 : (double) hits / (double) refs;
+            double miss_rate = refs == 0 ? 0.0 : (double) misses / (double) refs;
+            out << "  " << name << "  " << hits << "  " << misses << "  " << hit_rate << "  " << miss_rate
+                << "  " << misses - _misses;
+            if (_misses != 0)
+                out << " (+" << 100.0 * (double) (misses - _misses) / (double) _misses << "%)";
+            out << "\n";
+        };
+        out << "  policy  hits  misses  hit rate  miss rate  misses over min\n";
+        row("min", _hits, _misses);
+        for (size_t p = 0; p < _policies.size(); p++) {
+            const CacheStats& stats = _policies[p]->stats();
+            row(_policy_names[p], stats.hits, stats.misses);
+        }
+        out << "\n";
+    }
+}
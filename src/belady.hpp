@@ -0,0 +1,99 @@
+/*
+ * Belady's MIN,
+ * the offline optimal replacement of a cache, the baseline other policies are measured against
+ */
+
+#ifndef CACHE_SIM_BELADY_HPP
+#define CACHE_SIM_BELADY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "address_translator.hpp"
+#include "cache.hpp"
+#include "spill.hpp"
+
+namespace cs {
+
+/*
+ * a unified write-allocate cache that always evicts the line used again farthest in the future,
+ * which no replacement policy can beat on misses (without bypassing the cache)
+ *
+ * two passes over the recorded trace:
+ *   a backward pass stores, per reference, the distance to the next use of its block,
+ *   the forward pass keeps each set's lines in a max-heap on their next use,
+ *   so the victim is the root and a hit or fill rekeys one line in O(log ways)
+ *
+ * references are recorded as 32-bit block ids and distances as 32-bit counts,
+ * 8 bytes a reference, spilled to mapped files past the memory budget
+ * a block next used 2^32 - 1 or more references later counts as never used again
+ *
+ * the policies given are run over the same blocks alongside, for the headroom they leave
+ */
+    class Belady {
+        static const uint32_t NEVER = UINT32_MAX; /* distance of a block that isn't used again */
+        static const size_t BATCH = 16384; /* references per batch run through the policies */
+
+        AddressTranslator *_at;
+        size_t _block_size;
+        int _num_sets, _ways;
+
+        std::unordered_map<uint64_t, uint32_t> _ids; /* block address -> id */
+        std::vector<uint64_t> _blocks; /* id -> block address */
+        std::vector<uint32_t> _sets; /* id -> set */
+        SpillArray<uint32_t> _trace; /* block id of every reference */
+        SpillArray<uint32_t> _next; /* distance from every reference to the next use of its block */
+
+        uint64_t _hits, _misses;
+        std::vector<std::string> _policy_names;
+        std::vector<std::unique_ptr<Cache>> _policies;
+
+        /* the distances, from the end of the trace back */
+        void backward();
+
+        /* the cache itself, with the policies alongside */
+        void forward();
+
+    public:
+    /*
+     * a cache of num_sets sets of ways lines of block_size bytes,
+     * compared with every policy named, memory is the budget in bytes of the recorded trace
+     * throws AddressTranslation on inconsistent geometry, InvalidConfig on unknown policies
+     */
+        Belady(size_t block_size, int num_sets, int ways, unsigned address_size,
+               const std::vector<std::string>& policies, size_t memory);
+        ~Belady();
+
+        Belady(const Belady&) = delete;
+        Belady& operator=(const Belady&) = delete;
+
+    /*
+     * records the next reference, throws AddressTranslation if it's too wide
+     * and CSException past 2^32 - 1 distinct blocks
+     */
+        void access(uint64_t address);
+
+    /*
+     * simulates everything recorded
+     */
+        void run();
+
+        uint64_t references() const { return _trace.size(); }
+        uint64_t hits() const { return _hits; }
+        uint64_t misses() const { return _misses; }
+        uint64_t compulsory_misses() const { return _blocks.size(); }
+
+    /*
+     * hits and misses of MIN and of each policy, with how many more misses they take
+     */
+        void summary(std::ostream& out) const;
+    };
+
+}
+
+#endif //CACHE_SIM_BELADY_HPP
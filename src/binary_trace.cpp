@@ -0,0 +1,124 @@
+/*
+ * Binary trace definition
+ */
+
+#include "binary_trace.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cs {
+
+    static const char BINARY_TRACE_MAGIC[8] = {'C', 'S', 'T', 'R', 'A', 'C', 'E', '\0'};
+
+    /* references handed out per batch, keeps the touched part of the mapping small */
+    static const size_t BINARY_BATCH = 1 << 16;
+
+    bool BinaryTrace::is_binary(const char *buf, size_t len) {
+        return len >= sizeof(BINARY_TRACE_MAGIC) && memcmp(buf, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+    }
+
+    BinaryTrace::BinaryTrace(const char *path)
+            : _fd(-1), _map(MAP_FAILED), _map_len(0), _header(nullptr), _refs(nullptr), _pos(0) {
+
+        _fd = ::open(path, O_RDONLY);
+        if (_fd < 0)
+            throw CSException("invalid input file");
+
+        struct stat st;
+        if (fstat(_fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(BinaryTraceHeader)) {
+            ::close(_fd);
+            throw CSException("invalid binary trace -- file too short");
+        }
+
+        _map_len = st.st_size;
+        _map = mmap(nullptr, _map_len, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (_map == MAP_FAILED) {
+            ::close(_fd);
+            throw CSException("invalid binary trace -- cannot map file");
+        }
+        madvise(_map, _map_len, MADV_SEQUENTIAL);
+
+        _header = static_cast<const BinaryTraceHeader *>(_map);
+        _refs = reinterpret_cast<const Reference *>(_header + 1);
+
+        const char *error = nullptr;
+        if (!is_binary(_header->magic, sizeof(_header->magic)))
+            error = "invalid binary trace -- bad magic";
+        else if (_header->version != BINARY_TRACE_VERSION)
+            error = "invalid binary trace -- unsupported version";
+        else if (_header->address_size == 0 || _header->address_size > 64)
+            error = "invalid binary trace -- bad address size";
+        else if (_header->count != (_map_len - sizeof(BinaryTraceHeader)) / sizeof(Reference)
+                 || (_map_len - sizeof(BinaryTraceHeader)) % sizeof(Reference) != 0)
+            error = "invalid binary trace -- record count doesn't match file size";
+
+        if (error != nullptr) {
+            munmap(_map, _map_len);
+            ::close(_fd);
+            throw CSException(error);
+        }
+    }
+
+    BinaryTrace::~BinaryTrace() {
+        munmap(_map, _map_len);
+        ::close(_fd);
+    }
+
+    size_t BinaryTrace::next_batch(const Reference *&batch) {
+        size_t n = _header->count - _pos;
+        if (n > BINARY_BATCH)
+            n = BINARY_BATCH;
+        batch = _refs + _pos;
+        _pos += n;
+        return n;
+    }
+
+    uint64_t BinaryTrace::seek(uint64_t count) {
+        uint64_t n = _header->count - _pos;
+        if (n > count)
+            n = count;
+        _pos += n;
+        return n;
+    }
+
+    BinaryTraceWriter::BinaryTraceWriter(const char *path, unsigned address_size) {
+        _out = std::fopen(path, "wb");
+        if (_out == nullptr)
+            throw CSException("invalid output file");
+        std::setvbuf(_out, nullptr, _IOFBF, 1 << 20);
+
+        memcpy(_header.magic, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC));
+        _header.version = BINARY_TRACE_VERSION;
+        _header.address_size = address_size;
+        _header.count = 0;
+        _header.reserved = 0;
+
+        /* placeholder, rewritten with the final count on close */
+        if (std::fwrite(&_header, sizeof(_header), 1, _out) != 1)
+            throw CSException("error writing output file");
+    }
+
+    BinaryTraceWriter::~BinaryTraceWriter() {
+        if (_out != nullptr)
+            std::fclose(_out);
+    }
+
+    void BinaryTraceWriter::write(const Reference& ref) {
+        if (std::fwrite(&ref, sizeof(ref), 1, _out) != 1)
+            throw CSException("error writing output file");
+        _header.count++;
+    }
+
+    void BinaryTraceWriter::close() {
+        if (std::fseek(_out, 0, SEEK_SET) != 0
+            || std::fwrite(&_header, sizeof(_header), 1, _out) != 1
+            || std::fclose(_out) != 0) {
+            _out = nullptr;
+            throw CSException("error writing output file");
+        }
+        _out = nullptr;
+    }
+}
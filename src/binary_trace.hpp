@@ -0,0 +1,108 @@
+/*
+ * Binary trace format,
+ * a pre-decoded trace that can be mapped and fed to the driver without parsing
+ *
+ * layout (host byte order, little-endian on every platform we run on):
+ *
+ *   header, 32 bytes
+ *     char     magic[8]      "CSTRACE" followed by '\0'
+ *     uint32   version       BINARY_TRACE_VERSION
+ *     uint32   address_size  width of the addresses in bits
+ *     uint64   count         number of records
+ *     uint64   reserved      0
+ *
+ *   count records, 16 bytes each -- the in-memory layout of cs::Reference
+ *     uint64   address
+ *     int32    type          DATA_READ, DATA_WRITE or INSTRUCTION_READ
+ *     uint32   reserved      0
+ */
+
+#ifndef CACHE_SIM_BINARY_TRACE_HPP
+#define CACHE_SIM_BINARY_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "errors.hpp"
+#include "reference.hpp"
+#include "trace_source.hpp"
+
+namespace cs {
+
+    const uint32_t BINARY_TRACE_VERSION = 1;
+
+    struct BinaryTraceHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t address_size;
+        uint64_t count;
+        uint64_t reserved;
+    };
+
+    static_assert(sizeof(BinaryTraceHeader) == 32, "binary trace header must be 32 bytes");
+    static_assert(sizeof(Reference) == 16, "binary trace records must be 16 bytes");
+
+/*
+ * memory mapped binary trace, hands out the mapped records directly
+ */
+    class BinaryTrace : public TraceSource {
+        int _fd;
+        void *_map;
+        size_t _map_len;
+        const BinaryTraceHeader *_header;
+        const Reference *_refs;
+        size_t _pos;
+
+    public:
+    /*
+     * maps the binary trace at path
+     * throws CSException when it can't be opened or isn't a valid binary trace
+     */
+        explicit BinaryTrace(const char *path);
+        ~BinaryTrace() override;
+
+        BinaryTrace(const BinaryTrace&) = delete;
+        BinaryTrace& operator=(const BinaryTrace&) = delete;
+
+        size_t next_batch(const Reference *&batch) override;
+        uint64_t seek(uint64_t count) override;
+
+        const Reference *data() const { return _refs; }
+        size_t size() const { return _header->count; }
+        unsigned address_size() const { return _header->address_size; }
+
+    /*
+     * true if the first bytes of buf are the binary trace magic
+     */
+        static bool is_binary(const char *buf, size_t len);
+    };
+
+/*
+ * writes a binary trace, the record count is filled in by close()
+ */
+    class BinaryTraceWriter {
+        std::FILE *_out;
+        BinaryTraceHeader _header;
+
+    public:
+    /*
+     * throws CSException when path can't be created
+     */
+        BinaryTraceWriter(const char *path, unsigned address_size);
+        ~BinaryTraceWriter();
+
+        BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+        BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+        void write(const Reference& ref);
+
+    /*
+     * flushes the records and writes the final header
+     */
+        void close();
+    };
+
+}
+
+#endif //CACHE_SIM_BINARY_TRACE_HPP
@@ -2,70 +2,285 @@
  * Author: Parsa Bagheri
  */
 
-#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <utility>
 #include "cache.hpp"
+#include "tag_match.hpp"
 
 namespace cs {
 
-    bool CacheSet::fetch(int tag, int& hits, int& misses, std::unordered_set<int> *dirties) {
-
-        bool has = false;
-        if (!has_addr(tag)) {
-            if (_size >= _cap) {
-                int victim = select_victim(misses);
-                if (dirties != nullptr) {
-                    if (dirties->count(victim) != 0) {
-                        if (_debug)
-                            std::cerr << "     miss -- victim was dirty -- writing back to memory\n";
-                        misses++;
-                    }
-                }
-                _tags.erase(_tags.find(victim));
-                _size--;
+    /*
+     * cache line aligned allocation, released with free()
+     */
+    static void *aligned_array(size_t bytes) {
+        void *ptr = nullptr;
+        if (posix_memalign(&ptr, 64, bytes != 0 ? bytes : 64) != 0)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    /*
+     * sets of a cache, throws AddressTranslation when they don't fit a set index
+     */
+    static int sets_of(size_t total_size, size_t block_size, int blocks_per_set) {
+        if (block_size == 0 || blocks_per_set <= 0)
+            throw AddressTranslation();
+        uint64_t sets = total_size / (block_size * static_cast<uint64_t>(blocks_per_set));
+        if (sets > static_cast<uint64_t>(AddressTranslator::MAX_SETS))
+            throw AddressTranslation();
+        return static_cast<int>(sets);
+    }
+
+    int Cache::lookup(int slot, uint64_t tag) const {
+        return match_tag(_tags + line(slot, 0), _ways, tag);
+    }
+
+    template <bool Observed>
+    bool Cache::fetch(int set, uint64_t tag, size_t& at, CacheStats& stats) {
+
+        if (TRACING)
+            _traced_eviction = false;
+
+        int s = slot(set);
+        int way = lookup(s, tag);
+        if (way >= 0) {
+            at = line(s, way);
+            _meta[at].count++;
+            _policy->touch(s, way);
+            return true;
+        }
+
+        way = lookup(s, INVALID_TAG);
+        if (way < 0) {
+            way = select_victim(s);
+            size_t victim = line(s, way);
+            bool dirty = (_meta[victim].flags & LINE_DIRTY) != 0;
+            if (dirty)
+                stats.writebacks++;
+            if (TRACING) {
+                _traced_eviction = true;
+                _traced_dirty = dirty;
+                _traced_victim = _at->block_address(_tags[victim], static_cast<uint64_t>(set));
+            }
+            if (_track_evictions) {
+                _evicted = true;
+                _victim_dirty = dirty;
+                _victim = _at->block_address(_tags[victim], static_cast<uint64_t>(set));
+            } else if (dirty && _log_writebacks) {
+                _writebacks.push_back(Writeback{_current, _at->block_address(_tags[victim], static_cast<uint64_t>(set))});
             }
-            _tags.insert({tag, 1});
-            _size++;
+            if (Observed) {
+                observed(EVENT_EVICT, set, _at->block_address(_tags[victim], static_cast<uint64_t>(set)));
+                if (dirty)
+                    observed(EVENT_WRITEBACK, set, _at->block_address(_tags[victim], static_cast<uint64_t>(set)));
+            }
+        }
+        at = line(s, way);
+        _tags[at] = tag;
+        _meta[at] = LineMeta{1, 0};
+        _policy->fill(s, way);
+        if (Observed)
+            observed(EVENT_FILL, set, _at->block_address(tag, static_cast<uint64_t>(set)));
+        return false;
+    }
+
+    int Cache::probe(uint64_t addr, bool extract, bool& dirty) {
+        Addr address = _at->decode(addr);
+        int s = find_slot(address.set);
+        int way = s >= 0 ? lookup(s, address.tag) : -1;
+        dirty = false;
+        if (TRACING && _sink != nullptr)
+            traced(TRACE_PROBE, address, way >= 0);
+        if (_observed)
+            observed(address, way >= 0);
+        if (_classifier != nullptr)
+            classified(address, way >= 0, _stats);
+        if (way < 0) {
+            _stats.misses++;
+            return MISS;
+        }
+        _stats.hits++;
+        if (extract) {
+            dirty = (_meta[line(s, way)].flags & LINE_DIRTY) != 0;
+            if (_observed)
+                observed(EVENT_EVICT, address.set, addr - address.offset);
+            _tags[line(s, way)] = INVALID_TAG;
+            _meta[line(s, way)] = LineMeta{0, 0};
         } else {
-            _tags.at(tag)++;
-            has = true;
+            _meta[line(s, way)].count++;
+            _policy->touch(s, way);
         }
-        return has;
+        return HIT;
+    }
+
+    void Cache::fill(uint64_t addr, bool dirty) {
+        Addr address = _at->decode(addr);
+        size_t at;
+        bool hit = _observed ? fetch<true>(address.set, address.tag, at, _stats)
+                            : fetch<false>(address.set, address.tag, at, _stats);
+        if (TRACING && _sink != nullptr)
+            traced(TRACE_FILL, address, hit);
+        if (dirty)
+            _meta[at].flags |= LINE_DIRTY;
+    }
+
+    void Cache::mark_dirty(uint64_t addr) {
+        Addr address = _at->decode(addr);
+        int s = find_slot(address.set);
+        int way = s >= 0 ? lookup(s, address.tag) : -1;
+        if (way >= 0)
+            _meta[line(s, way)].flags |= LINE_DIRTY;
     }
 
-    void CacheSet::insert(int tag) {
-        if (has_addr(tag)) {
-            _tags.at(tag)++;
+    bool Cache::invalidate(uint64_t addr) {
+        Addr address = _at->decode(addr);
+        int s = find_slot(address.set);
+        int way = s >= 0 ? lookup(s, address.tag) : -1;
+        if (TRACING && _sink != nullptr)
+            traced(TRACE_INVALIDATE, address, way >= 0);
+        if (way < 0)
+            return false;
+        bool dirty = (_meta[line(s, way)].flags & LINE_DIRTY) != 0;
+        if (dirty)
+            _stats.writebacks++;
+        if (_observed) {
+            observed(EVENT_EVICT, address.set, addr - address.offset);
+            if (dirty)
+                observed(EVENT_WRITEBACK, address.set, addr - address.offset);
         }
+        _tags[line(s, way)] = INVALID_TAG;
+        _meta[line(s, way)] = LineMeta{0, 0};
+        return dirty;
     }
 
-    int CacheSet::select_victim(int& misses) {
-        int min_freq = INT32_MAX;
-        int key = _tags.begin()->first;
-        for (auto it: _tags) {
-            if (it.second < min_freq) {
-                min_freq = it.second;
-                key = it.first;
-            }
+    bool Cache::invalidate_range(uint64_t base, size_t bytes) {
+        uint64_t end = base + bytes;
+        bool dirty = false;
+        for (uint64_t addr = base - base % _block_size; addr < end; addr += _block_size)
+            dirty |= invalidate(addr);
+        return dirty;
+    }
+
+    int Cache::select_victim(int slot) {
+        return _policy->victim(slot, _meta + line(slot, 0));
+    }
+
+    int Cache::materialize(int set) {
+        int slot = _directory->slot(set);
+        if (slot >= _slots)
+            grow_store();
+        _policy->place(slot, set);
+        return slot;
+    }
+
+    void Cache::grow_store() {
+        int slots = _slots * 2 < _num_sets ? _slots * 2 : _num_sets;
+        size_t lines = static_cast<size_t>(_slots) * _ways, grown = static_cast<size_t>(slots) * _ways;
+        uint64_t *tags = static_cast<uint64_t *>(aligned_array(grown * sizeof(uint64_t)));
+        LineMeta *meta = static_cast<LineMeta *>(aligned_array(grown * sizeof(LineMeta)));
+        for (size_t i = 0; i < grown; i++) {
+            tags[i] = i < lines ? _tags[i] : INVALID_TAG;
+            meta[i] = i < lines ? _meta[i] : LineMeta{0, 0};
+        }
+        free(_tags);
+        free(_meta);
+        _tags = tags;
+        _meta = meta;
+        _policy->resize(slots);
+        _slots = slots;
+    }
+
+    void Cache::traced(int op, const Addr& address, bool hit) {
+        TraceEvent event = {_name.c_str(), op,
+                            _at->block_address(address.tag, static_cast<uint64_t>(address.set)) | address.offset,
+                            address.set, address.tag, hit, _traced_eviction, _traced_dirty, _traced_victim};
+        _sink->emit(event);
+        _traced_eviction = false;
+    }
+
+    std::vector<StateSpan> Cache::state() {
+        size_t lines = static_cast<size_t>(_slots) * _ways;
+        std::vector<StateSpan> spans = {
+                {_tags, lines * sizeof(uint64_t)},
+                {_meta, lines * sizeof(LineMeta)},
+                {&_stats, sizeof(_stats)}
+        };
+        for (auto& span : _policy->state())
+            spans.push_back(span);
+        if (_classifier != nullptr) {
+            for (auto& span : _classifier->state())
+                spans.push_back(span);
+        }
+        return spans;
+    }
+
+    void Cache::classify_batch() {
+        uint64_t counts[3] = {0, 0, 0};
+        _classifier->drain(counts);
+        _stats.compulsory += counts[MISS_COMPULSORY];
+        _stats.capacity += counts[MISS_CAPACITY];
+        _stats.conflict += counts[MISS_CONFLICT];
+    }
+
+    void Cache::classify(bool on) {
+        if (!on) {
+            delete _classifier;
+            _classifier = nullptr;
+        } else if (_classifier == nullptr) {
+            if (static_cast<uint64_t>(_num_sets) * _ways >= MissClassifier::MAX_LINES)
+                throw CSException("too many lines to classify misses -- run with -N");
+            _classifier = new MissClassifier(static_cast<size_t>(_num_sets) * _ways);
+        }
+    }
+
+    void Cache::warm(bool on) {
+        if (on == _warming)
+            return;
+        _warming = on;
+        std::swap(_classifier, _idle_classifier);
+        if (on) {
+            _kept_stats = _stats;
+            _observed = false;
+        } else {
+            _stats = _kept_stats;
+            _observed = !_observers.empty();
         }
-        if (_debug)
-            std::cerr << "cache full -- victim selected by lru :   " << key << "  #ref: " << min_freq << "\n";
-        return key;
     }
 
-    bool CacheSet::has_addr(int tag) {
-        return _tags.count(tag) != 0;
+    void Cache::observe(CacheObserver *observer) {
+        _observers.push_back(observer);
+        _observed = true;
+        _events.reserve(EVENT_BATCH);
+    }
+
+    void Cache::flush_events() {
+        if (_events.empty())
+            return;
+        for (auto observer : _observers)
+            observer->observe(*this, _events.data(), _events.size());
+        _events.clear();
     }
 
     double Cache::get_hit_rate() {
-        if (_hits + _misses == 0)
+        if (_stats.hits + _stats.misses == 0)
             return 0.0;
-        return ((double)_hits)/(double)(_hits + _misses);
+        return ((double)_stats.hits)/(double)(_stats.hits + _stats.misses);
     }
 
     double Cache::get_miss_rate() {
-        if (_hits + _misses == 0)
+        if (_stats.hits + _stats.misses == 0)
             return 0.0;
-        return ((double)_misses)/(double)(_hits + _misses);
+        return ((double)_stats.misses)/(double)(_stats.hits + _stats.misses);
+    }
+
+    void Cache::add_stats(const CacheStats& stats) {
+        _stats.hits += stats.hits;
+        _stats.misses += stats.misses;
+        _stats.writebacks += stats.writebacks;
+        _stats.compulsory += stats.compulsory;
+        _stats.capacity += stats.capacity;
+        _stats.conflict += stats.conflict;
     }
 
     double Cache::average_memory_access_time() {
@@ -74,11 +289,22 @@ namespace cs {
 
     void Cache::summary(std::ostream& out) {
         out << "summary of " << type() << " cache:\n";
-        out << "  number of memory accesses: " << _misses + _hits << "\n";
-        out << "  number of hits: " << _hits << "\n";
-        out << "  number of misses: " << _misses << "\n";
+        out << "  number of memory accesses: " << _stats.misses + _stats.hits << "\n";
+        out << "  number of hits: " << _stats.hits << "\n";
+        out << "  number of misses: " << _stats.misses << "\n";
+        out << "  number of writebacks: " << _stats.writebacks << "\n";
         out << "  hit rate: " << get_hit_rate() << "\n";
         out << "  miss rate: " << get_miss_rate() << "\n";
+        if (_classifier != nullptr) {
+            out << "  compulsory misses: " << _stats.compulsory << "\n";
+            out << "  capacity misses: " << _stats.capacity << "\n";
+            out << "  conflict misses: " << _stats.conflict << "\n";
+            uint64_t through = _stats.misses - _stats.compulsory - _stats.capacity - _stats.conflict;
+            if (through != 0)
+                out << "  write hits sent through: " << through << "\n";
+        }
+        if (_directory != nullptr)
+            out << "  sets touched: " << _directory->size() << " of " << _num_sets << "\n";
         out << "\n";
     }
 
@@ -89,112 +315,222 @@ namespace cs {
                  int hit_time,
                  int miss_penalty,
                  const Memory *memory,
-                 bool debug)
-        : _total_size(total_size), _block_size(block_size), _num_sets(int(total_size/(block_size*blocks_per_set))),
-          _bps(blocks_per_set), _hit_time(hit_time), _miss_penalty(miss_penalty),
-          _main_memory(memory), _hits(0), _misses(0), _debug(debug){
-
-        if (_debug) {
-            std::cerr << "======[ initializing cache ]======\n"
-                      << "total size = " << _total_size << "B\n"
-                      << "block size = " << _block_size << "B\n"
-                      << "set size: " << blocks_per_set * block_size << "B\n"
-                      << "number of sets = " << _num_sets << "\n"
-                      << "number of blocks per set = " << _bps << "\n\n";
-        }
+                 const std::string& replacement,
+                 bool sparse)
+        : _total_size(total_size), _block_size(block_size),
+          _bps(blocks_per_set), _num_sets(sets_of(total_size, block_size, blocks_per_set)),
+          _stats{0, 0, 0, 0, 0, 0}, _hit_time(hit_time), _miss_penalty(miss_penalty), _main_memory(memory),
+          _directory(nullptr), _slots(0),
+          _track_evictions(false), _evicted(false), _victim_dirty(false), _victim(0),
+          _log_writebacks(false), _current(0), _observed(false), _classifier(nullptr), _batching(false),
+          _warming(false), _idle_classifier(nullptr), _kept_stats{0, 0, 0, 0, 0, 0}, _sink(nullptr), _traced_eviction(false), _traced_dirty(false), _traced_victim(0) {
 
     /*
      * creating address translator
      */
         _at = new AddressTranslator(total_size,address_size,block_size,
-                                    _num_sets,_bps,_debug);
+                                    _num_sets,_bps);
 
     /*
-     * creating our sets
+     * creating our sets, one block of tags and one of metadata for all of them,
+     * or for the first few a sparse store materializes
      */
-        _sets = new CacheSet*[_num_sets];
-        for (int i = 0; i < _num_sets; i++)
-            _sets[i] = new CacheSet(_bps, _block_size, _debug);
+        _ways = _bps;
+        _slots = sparse && _num_sets > SPARSE_SLOTS ? SPARSE_SLOTS : _num_sets;
+        if (sparse)
+            _directory = new SetDirectory();
+        _policy = ReplacementPolicy::create(replacement, _slots, _ways);
+        size_t lines = static_cast<size_t>(_slots) * _ways;
+        _tags = static_cast<uint64_t *>(aligned_array(lines * sizeof(uint64_t)));
+        _meta = static_cast<LineMeta *>(aligned_array(lines * sizeof(LineMeta)));
+        for (size_t i = 0; i < lines; i++) {
+            _tags[i] = INVALID_TAG;
+            _meta[i] = LineMeta{0, 0};
+        }
+        if (static_cast<uint64_t>(_num_sets) * _ways < MissClassifier::MAX_LINES)
+            _classifier = new MissClassifier(static_cast<size_t>(_num_sets) * _ways);
     }
 
     Cache::~Cache() {
-        for (int i = 0; i < _num_sets; i++)
-            delete _sets[i];
-        delete [] _sets;
+        delete _classifier;
+        delete _idle_classifier;
+        delete _directory;
+        free(_tags);
+        free(_meta);
+        delete _policy;
         delete _at;
     }
 
-    int WriteThrough::read (const char *addr) {
+    int WriteThrough::read (uint64_t addr, CacheStats& stats) {
         Addr address = _at->translate(addr);
-        if (_sets[address.set]->fetch(address.tag, _hits, _misses)) {
-            if (_debug)
-                std::cerr << "     read hit\n\n";
-            _hits++;
+        return _observed ? read_line<true>(address, stats) : read_line<false>(address, stats);
+    }
+
+    int WriteThrough::write (uint64_t addr, CacheStats& stats) {
+        Addr address = _at->translate(addr);
+        return _observed ? write_line<true>(address, stats) : write_line<false>(address, stats);
+    }
+
+    size_t WriteThrough::exec_batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) {
+        _batching = _classifier != nullptr;
+        size_t missed = _observed ? batch<true>(refs, idx, count, misses) : batch<false>(refs, idx, count, misses);
+        if (_batching) {
+            _batching = false;
+            classify_batch();
+        }
+        return missed;
+    }
+
+    template <bool Observed>
+    size_t WriteThrough::batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) {
+        size_t missed = 0;
+        for (size_t i = 0; i < count; i++) {
+            const Reference& ref = refs[idx[i]];
+            Addr address = _at->decode(ref.address);
+            int result = is_write(ref.type) ? write_line<Observed>(address, _stats) : read_line<Observed>(address, _stats);
+            if (result == MISS)
+                misses[missed++] = idx[i];
+        }
+        return missed;
+    }
+
+    template <bool Observed>
+    int WriteThrough::read_line (Addr address, CacheStats& stats) {
+        size_t at;
+        if (fetch<Observed>(address.set, address.tag, at, stats)) {
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_READ, address, true);
+            if (Observed)
+                observed(address, true);
+            if (_classifier != nullptr)
+                classified(address, true, stats);
+            stats.hits++;
             return HIT;
         } else {
-            if (_debug)
-                std::cerr << "     read miss\n\n";
-            _sets[address.set]->insert(address.tag);
-            _misses++;
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_READ, address, false);
+            if (Observed)
+                observed(address, false);
+            if (_classifier != nullptr)
+                classified(address, false, stats);
+            _meta[at].count++;
+            stats.misses++;
             return MISS;
         }
     }
 
-    int WriteThrough::write (const char *addr) {
-        Addr address = _at->translate(addr);
-        if (_sets[address.set]->fetch(address.tag, _hits, _misses)) {
-            if (_debug)
-                std::cerr << "     write hit\n";
-            _hits++;
-            if (_debug)
-                std::cerr << "     write miss -- writing through\n\n";
-            _misses++; /* we are also writing through to the memory */
+    template <bool Observed>
+    int WriteThrough::write_line (Addr address, CacheStats& stats) {
+        size_t at;
+        if (fetch<Observed>(address.set, address.tag, at, stats)) {
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_WRITE, address, true);
+            if (Observed)
+                observed(address, true);
+            if (_classifier != nullptr)
+                classified(address, true, stats);
+            stats.hits++;
+            stats.misses++; /* we are also writing through to the memory */
             return MISS;
         } else {
-            if (_debug)
-                std::cerr << "     write miss -- writing through\n\n";
-            _misses++;
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_WRITE, address, false);
+            if (Observed)
+                observed(address, false);
+            if (_classifier != nullptr)
+                classified(address, false, stats);
+            stats.misses++;
             return MISS;
         }
     }
 
-    int WriteBack::read (const char *addr) {
+    int WriteBack::read (uint64_t addr, CacheStats& stats) {
+        Addr address = _at->translate(addr);
+        return _observed ? read_line<true>(address, stats) : read_line<false>(address, stats);
+    }
+
+    int WriteBack::write (uint64_t addr, CacheStats& stats) {
         Addr address = _at->translate(addr);
-        if (_sets[address.set]->fetch(address.tag, _hits, _misses, &_dirties)) {
-            if (_debug)
-                std::cerr << "     read hit\n\n";
-            _hits++;
+        return _observed ? write_line<true>(address, stats) : write_line<false>(address, stats);
+    }
+
+    size_t WriteBack::exec_batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) {
+        _batching = _classifier != nullptr;
+        size_t missed = _observed ? batch<true>(refs, idx, count, misses) : batch<false>(refs, idx, count, misses);
+        if (_batching) {
+            _batching = false;
+            classify_batch();
+        }
+        return missed;
+    }
+
+    template <bool Observed>
+    size_t WriteBack::batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) {
+        size_t missed = 0;
+        for (size_t i = 0; i < count; i++) {
+            const Reference& ref = refs[idx[i]];
+            Addr address = _at->decode(ref.address);
+            _current = idx[i];
+            int result = is_write(ref.type) ? write_line<Observed>(address, _stats) : read_line<Observed>(address, _stats);
+            if (result == MISS)
+                misses[missed++] = idx[i];
+        }
+        return missed;
+    }
+
+    template <bool Observed>
+    int WriteBack::read_line (Addr address, CacheStats& stats) {
+        size_t at;
+        if (fetch<Observed>(address.set, address.tag, at, stats)) {
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_READ, address, true);
+            if (Observed)
+                observed(address, true);
+            if (_classifier != nullptr)
+                classified(address, true, stats);
+            stats.hits++;
             return HIT;
         } else {
-            if (_debug)
-                std::cerr << "     read miss\n\n";
-            _sets[address.set]->insert(address.tag);  /* up the reference count*/
-            _misses++;
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_READ, address, false);
+            if (Observed)
+                observed(address, false);
+            if (_classifier != nullptr)
+                classified(address, false, stats);
+            _meta[at].count++;  /* up the reference count*/
+            stats.misses++;
             return MISS;
         }
     }
 
-    int WriteBack::write (const char *addr) {
-        Addr address = _at->translate(addr);
-        if (_sets[address.set]->fetch(address.tag, _hits, _misses, &_dirties)) {
-            if (_debug)
-                std::cerr << "     write hit -- write back --  " << address.tag << " set dirty\n\n";
-            _hits++;
-            if (_dirties.count(address.tag) != 0)
-                _dirties.insert(address.tag); /* marking this block as dirty */
+    template <bool Observed>
+    int WriteBack::write_line (Addr address, CacheStats& stats) {
+        size_t at;
+        if (fetch<Observed>(address.set, address.tag, at, stats)) {
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_WRITE, address, true);
+            if (Observed)
+                observed(address, true);
+            if (_classifier != nullptr)
+                classified(address, true, stats);
+            stats.hits++;
+            _meta[at].flags |= LINE_DIRTY; /* marking this block as dirty */
             return HIT;
         } else {
             /*
-             * We're not bringing new cache line in when there's a write miss,
-             * we just write main memory -- no write allocate
+             * the block was brought in by fetch -- write allocate,
+             * the write goes to the cache only
              */
-            if (_debug)
-                std::cerr << "     write miss -- write allocate\n\n";
-            _misses++;
-            if (_dirties.count(address.tag) != 0)
-                _dirties.insert(address.tag); /* marking this block as dirty */
-            _sets[address.set]->insert(address.tag); /* up the reference count*/
+            if (TRACING && _sink != nullptr)
+                traced(TRACE_WRITE, address, false);
+            if (Observed)
+                observed(address, false);
+            if (_classifier != nullptr)
+                classified(address, false, stats);
+            stats.misses++;
+            _meta[at].flags |= LINE_DIRTY; /* marking this block as dirty */
+            _meta[at].count++; /* up the reference count*/
             return MISS;
         }
     }
-}
\ No newline at end of file
+}
@@ -6,13 +6,20 @@
 #define CACHE_SIM_CACHE_HPP
 
 #include <cstddef>
-#include <unordered_set>
-#include <unordered_map>
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <iostream>
 
 #include "memory.hpp"
 #include "errors.hpp"
 #include "address_translator.hpp"
+#include "replacement.hpp"
+#include "reference.hpp"
+#include "tracing.hpp"
+#include "observer.hpp"
+#include "miss_classifier.hpp"
+#include "set_directory.hpp"
 
 namespace cs { /* cache simulator */
 
@@ -21,34 +28,22 @@ namespace cs { /* cache simulator */
         MISS
     };
 
-    class CacheSet {
-    protected:
-        int _cap; /* number of cache lines in the set */
-        int _size;
-        bool _debug;
-        std::unordered_map<int, int> _tags; /* the blocks in each set, and number of times its referenced */
-    public:
-        CacheSet(int num_blocks, int capacity, bool debug)
-            : _cap(capacity), _debug(debug), _size(0), _tags(std::unordered_map<int, int>())
-        {}
-
-        /*
-         * looks up addr in set
-         *
-         * true if found, false otherwise
-         */
-        bool has_addr(int tag);
+/*
+ * hit and miss counters of a cache, 64 bits so no trace is long enough to wrap them,
+ * writebacks are dirty lines evicted, counted apart from the misses that evicted them,
+ * misses that fetched a block are split into the three C's, see MissClassifier
+ */
+    struct CacheStats {
+        uint64_t hits, misses, writebacks;
+        uint64_t compulsory, capacity, conflict;
+    };
 
-        /*
-         * fetches a block with tag `tag',
-         *  if tag wasn't found, it's line is brought to the cache
-         *  if cache is full, select a victim by victim policy
-         * return a bool, true if tag was found, false otherwise
-         */
-        bool fetch(int tag, int& hits, int& misses, std::unordered_set<int> *dirties = nullptr);
-        void insert(int tag);
-    protected:
-        virtual int select_victim(int& misses);
+/*
+ * a dirty block pushed out of a cache, logged for the level below
+ */
+    struct Writeback {
+        uint32_t at; /* index of the reference whose fill evicted it, see Cache::exec_batch */
+        uint64_t address; /* block address */
     };
 
 /*
@@ -60,19 +55,58 @@ namespace cs { /* cache simulator */
         int _bps; /* blocks per set */
         int _num_sets;
         AddressTranslator *_at;
-        int _hits, _misses;
-        bool _debug;
+        CacheStats _stats;
         int _hit_time, _miss_penalty;
         /*
          * following is a reference to higher level memory
          * could be main memory or higher level cache
          */
         const Memory *_main_memory;
-        CacheSet **_sets;
+
+        /*
+         * tag store covering every set, line `way' of set `set' lives at index set * _ways + way
+         * empty lines hold INVALID_TAG
+         * a sparse store indexes it, and the policy, by the set's slot in _directory instead,
+         * growing both as sets are touched, see slot()
+         */
+        int _ways; /* number of cache lines in each set */
+        uint64_t *_tags;
+        LineMeta *_meta;
+        ReplacementPolicy *_policy;
+        SetDirectory *_directory; /* nullptr for a dense store */
+        int _slots; /* sets the tag store has room for */
+
+        bool _track_evictions, _evicted, _victim_dirty;
+        uint64_t _victim; /* block address of the last eviction */
+
+        bool _log_writebacks;
+        uint32_t _current; /* index of the reference being run by exec_batch */
+        std::vector<Writeback> _writebacks;
+
+        std::string _name;
+
+        /* events recorded for the observers, only when there are any */
+        bool _observed;
+        std::vector<CacheObserver *> _observers;
+        std::vector<CacheEvent> _events;
+
+        MissClassifier *_classifier; /* nullptr when misses aren't classified */
+        bool _batching; /* inside exec_batch, classification is deferred to its end */
+
+        /* what warm() sets aside until warming ends */
+        bool _warming;
+        MissClassifier *_idle_classifier;
+        CacheStats _kept_stats;
+
+        /* tracing, only ever touched when TRACING is built in */
+        TraceSink *_sink;
+        bool _traced_eviction, _traced_dirty; /* what the last fetch evicted, for its event */
+        uint64_t _traced_victim;
 
     public:
-        double get_hits() { return (double)_hits;}
-        double get_misses() { return (double)_misses;}
+        double get_hits() { return (double)_stats.hits;}
+        double get_misses() { return (double)_stats.misses;}
+        double get_writebacks() { return (double)_stats.writebacks;}
 
         /* cache hit and miss rates */
         double get_hit_rate();
@@ -80,57 +114,296 @@ namespace cs { /* cache simulator */
 
         void summary(std::ostream& out);
 
-        virtual int read (const char *addr) = 0;
-        virtual int write (const char *addr) = 0;
+        int read (const char *addr) { return read(_at->parse(addr)); }
+        int write (const char *addr) { return write(_at->parse(addr)); }
+        int read (uint64_t addr) { return read(addr, _stats); }
+        int write (uint64_t addr) { return write(addr, _stats); }
+
+        /*
+         * read and write counting into `stats' instead of the cache's own counters,
+         * callers that touch disjoint sets may run these concurrently
+         */
+        virtual int read (uint64_t addr, CacheStats& stats) = 0;
+        virtual int write (uint64_t addr, CacheStats& stats) = 0;
+
+        /*
+         * runs refs[idx[0]] .. refs[idx[count - 1]] in order, DATA_WRITE as writes and the rest as reads,
+         * stores the indices of the references that missed in misses and returns how many did
+         * addresses must already be valid for this cache -- nothing is checked and nothing throws
+         */
+        virtual size_t exec_batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) = 0;
+
+        /*
+         * looks addr up without bringing it in on a miss, counting the hit or miss,
+         * with extract a hit removes the line (it moves to a level above)
+         * and dirty tells whether it was dirty
+         */
+        int probe (uint64_t addr, bool extract, bool& dirty);
+
+        /*
+         * brings the block holding addr in without counting an access,
+         * e.g. a victim handed down by the level above, dirty if it was dirty there
+         */
+        void fill (uint64_t addr, bool dirty = false);
+
+        /* marks the block holding addr dirty if it's cached */
+        void mark_dirty (uint64_t addr);
+
+        /*
+         * drops the block holding addr, true if it was cached dirty,
+         * which counts as a writeback the caller passes on
+         */
+        bool invalidate (uint64_t addr);
+
+        /* drops every block overlapping [base, base + bytes), true if any was dirty */
+        bool invalidate_range (uint64_t base, size_t bytes);
+
+        /*
+         * eviction tracking, off by default
+         * when on, evicted() reports the block address of a valid line pushed out
+         * by the last read, write or fill, once, and whether it was dirty
+         */
+        void track_evictions (bool on) { _track_evictions = on; _evicted = false; }
+        bool evicted (uint64_t& victim, bool& dirty) {
+            if (!_evicted)
+                return false;
+            _evicted = false;
+            victim = _victim;
+            dirty = _victim_dirty;
+            return true;
+        }
+
+        /*
+         * writeback logging, off by default
+         * when on, dirty lines evicted while eviction tracking is off are appended to writebacks(),
+         * in order, for the caller to pass on and clear
+         */
+        void log_writebacks (bool on) { _log_writebacks = on; _writebacks.clear(); }
+        std::vector<Writeback>& writebacks () { return _writebacks; }
+
+        /* name the cache goes by in traces and collected statistics, e.g. L1d */
+        const std::string& name () const { return _name; }
+        void set_name (const std::string& name) { _name = name; }
+
+        /*
+         * emits an event into sink for every access from now on,
+         * nullptr stops tracing, a no-op unless TRACING is built in
+         */
+        void trace (TraceSink *sink) { _sink = sink; }
+
+        /*
+         * adds an observer, which the cache doesn't own,
+         * events reach it in batches -- flush_events() hands over what's pending
+         * observed caches must be run from one thread
+         */
+        void observe (CacheObserver *observer);
+        void flush_events ();
+
+        size_t block_size () const { return _block_size; }
+        size_t total_size () const { return _total_size; }
+        int ways () const { return _ways; }
+
+        /* true if only the sets touched so far have tags and replacement state, and how many were */
+        bool sparse () const { return _directory != nullptr; }
+        int sets_touched () const { return _directory != nullptr ? _directory->size() : _num_sets; }
+
+        /*
+         * every array the cache's state lives in -- tags, line metadata with the dirty bits,
+         * counters, the replacement policy's state and the miss classifier's, if any, see Checkpoint
+         */
+        std::vector<StateSpan> state ();
+
+        /* true if the cache keeps writes until eviction, its misses fetch blocks with reads */
+        virtual bool writes_back () const { return false; }
+
+        /* true if addr fits the cache's address size */
+        bool valid (uint64_t addr) const { return _at->valid(addr); }
+
+        /* adds counters collected by the calls above to the cache's own */
+        void add_stats (const CacheStats& stats);
+        const CacheStats& stats () const { return _stats; }
+        void clear_stats () { _stats = CacheStats{0, 0, 0, 0, 0, 0}; }
+
+        /*
+         * three-C classification of the misses, on from construction for caches of under
+         * MissClassifier::MAX_LINES lines, off for callers that run the cache from several
+         * threads at once or don't need it, throws CSException to turn it on for bigger ones
+         */
+        void classify (bool on);
+        bool classifying () const { return _classifier != nullptr; }
+
+        /*
+         * size of the classifier's table of blocks touched, as log2 of its entries, 0 when not classifying,
+         * and an empty one of that size to restore a checkpoint into, see Checkpoint
+         */
+        unsigned classifier_bits () const { return _classifier != nullptr ? _classifier->table_bits() : 0; }
+        void resize_classifier (unsigned bits) { _classifier->resize_table(bits); }
+
+        /*
+         * functional warming, contents and replacement state only -- while on, misses aren't classified,
+         * observers see nothing and the counters are back to what they were once it's turned off
+         */
+        void warm (bool on);
+
+        /* set that addr maps to */
+        int set_of (uint64_t addr) { return _at->translate(addr).set; }
+        int num_sets () const { return _num_sets; }
         virtual std::string type () = 0 ;
+        const char *replacement () const { return _policy->name(); }
         double average_memory_access_time();
+        int hit_time () const { return _hit_time; }
+        int miss_penalty () const { return _miss_penalty; }
         virtual ~Cache();
+
+        static const uint64_t INVALID_TAG = ~uint64_t(0);
+        static const int SPARSE_SLOTS = 1024; /* sets a sparse store has room for from the start */
     protected:
+        /* a sparse store materializes sets as they're touched, see slot() */
         Cache(size_t total_size, size_t block_size, size_t address_size,
               int blocks_per_set, int hit_time, int miss_penalty,
-              const Memory *memory, bool debug);
+              const Memory *memory, const std::string& replacement, bool sparse);
+
+        /* index of line `way' of the set in slot `slot' of the tag store */
+        size_t line(int slot, int way) const { return static_cast<size_t>(slot) * _ways + way; }
+
+        /*
+         * slot of the tag store holding set, the set itself in a dense store,
+         * a sparse store materializes sets the first time they're looked up here
+         */
+        int slot(int set) {
+            if (_directory == nullptr)
+                return set;
+            int slot = _directory->find(set);
+            return slot >= 0 ? slot : materialize(set);
+        }
+
+        /* hands set the next slot of a sparse store, growing it when it's full */
+        int materialize(int set);
+
+        /* slot holding set, -1 for a set a sparse store hasn't materialized, which caches nothing */
+        int find_slot(int set) const { return _directory == nullptr ? set : _directory->find(set); }
+
+        /* doubles the room of a sparse store, tags, metadata and replacement state alike */
+        void grow_store();
+
+        /*
+         * looks up tag in the set in slot `slot'
+         *
+         * returns the way holding it, -1 if it isn't cached
+         */
+        int lookup(int slot, uint64_t tag) const;
+
+        /*
+         * fetches a block with tag `tag' into set `set',
+         *  if tag wasn't found, it's line is brought to the cache
+         *  if the set is full, select a victim by victim policy,
+         *  counting a writeback if it was dirty
+         * at is set to the index of the line holding tag, a newly filled line is clean
+         * return a bool, true if tag was found, false otherwise
+         * Observed records the events, instantiated apart so unobserved runs carry none of it
+         */
+        template <bool Observed>
+        bool fetch(int set, uint64_t tag, size_t& at, CacheStats& stats);
+
+        /*
+         * picks the way to evict from the full set in slot `slot', as the replacement policy decides
+         */
+        virtual int select_victim(int slot);
+
+        /*
+         * emits the event of an access to address that hit or missed,
+         * along with what its fetch evicted, callers check TRACING && _sink first
+         */
+        void traced(int op, const Addr& address, bool hit);
+
+        /* records an event for the observers, callers check _observed first */
+        void observed(int kind, int set, uint64_t block) {
+            _events.push_back(CacheEvent{kind, set, block});
+            if (_events.size() >= EVENT_BATCH)
+                flush_events();
+        }
+
+        /* records the hit or miss of an access to address, callers check _observed first */
+        void observed(const Addr& address, bool hit) {
+            observed(hit ? EVENT_HIT : EVENT_MISS, address.set,
+                     _at->block_address(address.tag, static_cast<uint64_t>(address.set)));
+        }
+
+        static const size_t EVENT_BATCH = 4096;
+
+        /*
+         * counts the class of a miss of address, and shows hits to the classifier, callers check _classifier first
+         * inside exec_batch the access is only queued, the batch is classified as a whole at its end
+         */
+        void classified(const Addr& address, bool hit, CacheStats& stats) {
+            uint64_t block = _at->block_address(address.tag, static_cast<uint64_t>(address.set));
+            if (_batching) {
+                _classifier->defer(block, hit);
+                return;
+            }
+            int c = _classifier->access(block, hit);
+            if (c == MISS_COMPULSORY)
+                stats.compulsory++;
+            else if (c == MISS_CAPACITY)
+                stats.capacity++;
+            else if (c == MISS_CONFLICT)
+                stats.conflict++;
+        }
+
+        /* classifies the accesses queued by the batch that just ran, into the cache's own counters */
+        void classify_batch();
     };
 
 /*
- * write-through cache system
+ * write-through cache system, lines are never dirty
  */
     class WriteThrough : public Cache {
     public:
         WriteThrough(size_t total_size, size_t block_size, size_t address_size,
                 int blocks_per_set, int hit_time, int miss_penalty,
-                const Memory *mem = nullptr, bool debug = false)
-          :Cache(total_size, block_size, address_size, blocks_per_set, hit_time, miss_penalty, mem, debug) {
-            if (debug) {
-                std::cerr << "[SUCCESS] write-through cache system initialized\n";
-                std::cerr << "================================================\n\n";
-            }
-        }
+                const Memory *mem = nullptr, const std::string& replacement = "lru", bool sparse = false)
+          :Cache(total_size, block_size, address_size, blocks_per_set, hit_time, miss_penalty, mem, replacement, sparse) {}
 
-        int read (const char *addr) override;
-        int write (const char *addr) override;
+        using Cache::read;
+        using Cache::write;
+        int read (uint64_t addr, CacheStats& stats) override;
+        int write (uint64_t addr, CacheStats& stats) override;
+        size_t exec_batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) override;
         std::string type () override { return "WriteThrough"; }
+    private:
+        template <bool Observed>
+        size_t batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses);
+        template <bool Observed>
+        int read_line (Addr address, CacheStats& stats);
+        template <bool Observed>
+        int write_line (Addr address, CacheStats& stats);
     };
 
 /*
- * write-back cache system
+ * write-back, write-allocate cache system,
+ * written lines are marked dirty and written back when they're evicted
  */
     class WriteBack : public Cache {
-        std::unordered_set<int> _dirties;
-
     public:
         WriteBack(size_t total_size, size_t block_size, size_t address_size,
                      int blocks_per_set, int hit_time, int miss_penalty,
-                     const Memory *mem = nullptr, bool debug = false)
-                :Cache(total_size, block_size, address_size, blocks_per_set, hit_time, miss_penalty, mem, debug) {
-            if (debug) {
-                std::cerr << "[SUCCESS] write-back cache system initialized\n";
-                std::cerr << "=============================================\n\n";
-            }
-        }
+                     const Memory *mem = nullptr, const std::string& replacement = "lru", bool sparse = false)
+                :Cache(total_size, block_size, address_size, blocks_per_set, hit_time, miss_penalty, mem, replacement, sparse) {}
 
-        int read (const char *addr) override;
-        int write (const char *addr) override;
+        using Cache::read;
+        using Cache::write;
+        int read (uint64_t addr, CacheStats& stats) override;
+        int write (uint64_t addr, CacheStats& stats) override;
+        size_t exec_batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) override;
         std::string type () override { return "WriteBack"; }
+        bool writes_back () const override { return true; }
+    private:
+        template <bool Observed>
+        size_t batch (const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses);
+        template <bool Observed>
+        int read_line (Addr address, CacheStats& stats);
+        template <bool Observed>
+        int write_line (Addr address, CacheStats& stats);
     };
 } /* cs namespace */
 
@@ -0,0 +1,238 @@
+/*
+ * Checkpoints definition
+ */
+
+#include "checkpoint.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cs {
+
+    static const char CHECKPOINT_MAGIC[8] = {'C', 'S', 'C', 'H', 'K', 'P', 'T', '\0'};
+    static const size_t ALIGN = 64;
+
+    struct CheckpointHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t caches;
+        uint64_t position;
+        uint64_t reserved[5];
+    };
+
+    struct CacheRecord {
+        char type[16];
+        char replacement[12];
+        uint32_t inclusion;
+        uint64_t total_size;
+        uint64_t block_size;
+        uint32_t sets;
+        uint32_t ways;
+        uint32_t spans;
+        uint32_t classifier;
+    };
+
+    static_assert(sizeof(CheckpointHeader) == ALIGN, "checkpoint header must be 64 bytes");
+    static_assert(sizeof(CacheRecord) == ALIGN, "checkpoint cache records must be 64 bytes");
+
+    static size_t padded(size_t bytes) {
+        return (bytes + ALIGN - 1) / ALIGN * ALIGN;
+    }
+
+    static CacheRecord record(Cache& cache, int inclusion, size_t spans) {
+        CacheRecord r;
+        memset(&r, 0, sizeof(r));
+        strncpy(r.type, cache.type().c_str(), sizeof(r.type) - 1);
+        strncpy(r.replacement, cache.replacement(), sizeof(r.replacement) - 1);
+        r.inclusion = static_cast<uint32_t>(inclusion);
+        r.total_size = cache.total_size();
+        r.block_size = cache.block_size();
+        r.sets = static_cast<uint32_t>(cache.num_sets());
+        r.ways = static_cast<uint32_t>(cache.ways());
+        r.spans = static_cast<uint32_t>(spans);
+        r.classifier = cache.classifier_bits();
+        return r;
+    }
+
+    /*
+     * the inclusion policy of every cache's level, in CacheDriver::caches() order
+     */
+    static std::vector<int> inclusions(CacheDriver& driver) {
+        std::vector<int> all;
+        for (size_t l = 0; l < driver.levels(); l++)
+            all.insert(all.end(), driver.caches(l).size(), driver.inclusion(l));
+        return all;
+    }
+
+    /*
+     * writes bytes and zeroes up to the next 64-byte boundary
+     */
+    static void write_padded(std::FILE *out, const void *data, size_t bytes) {
+        static const char zeros[ALIGN] = {0};
+        if ((bytes != 0 && std::fwrite(data, bytes, 1, out) != 1)
+            || (padded(bytes) != bytes && std::fwrite(zeros, padded(bytes) - bytes, 1, out) != 1))
+            throw CSException("error writing checkpoint");
+    }
+
+    /*
+     * a sparse store's sets sit in slots handed out as they were touched, by a directory checkpoints don't carry
+     */
+    static void check_dense(const std::vector<Cache *>& caches) {
+        for (auto cache : caches) {
+            if (cache->sparse())
+                throw InvalidConfig(cache->name() + " has a sparse store, checkpoints need dense ones");
+        }
+    }
+
+    void Checkpoint::save(CacheDriver& driver, uint64_t position, const char *path) {
+        std::vector<Cache *> caches = driver.caches();
+        std::vector<int> inclusion = inclusions(driver);
+        check_dense(caches);
+        std::FILE *out = std::fopen(path, "wb");
+        if (out == nullptr)
+            throw CSException("invalid checkpoint file");
+        std::setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+        try {
+            CheckpointHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+            header.version = CHECKPOINT_VERSION;
+            header.caches = static_cast<uint32_t>(caches.size());
+            header.position = position;
+            write_padded(out, &header, sizeof(header));
+
+            for (size_t c = 0; c < caches.size(); c++) {
+                std::vector<StateSpan> spans = caches[c]->state();
+                CacheRecord r = record(*caches[c], inclusion[c], spans.size());
+                write_padded(out, &r, sizeof(r));
+                for (auto& span : spans) {
+                    uint64_t bytes = span.bytes;
+                    write_padded(out, &bytes, sizeof(bytes));
+                    write_padded(out, span.data, span.bytes);
+                }
+            }
+        } catch (...) {
+            std::fclose(out);
+            throw;
+        }
+        if (std::fclose(out) != 0)
+            throw CSException("error writing checkpoint");
+    }
+
+    /*
+     * read-only mapping of a whole file, unmapped when it goes out of scope
+     */
+    class Mapping {
+        int _fd;
+        void *_map;
+        size_t _len;
+    public:
+        explicit Mapping(const char *path) : _fd(-1), _map(MAP_FAILED), _len(0) {
+            _fd = ::open(path, O_RDONLY);
+            struct stat st;
+            if (_fd < 0 || fstat(_fd, &st) != 0) {
+                if (_fd >= 0)
+                    ::close(_fd);
+                throw CSException("invalid checkpoint file");
+            }
+            _len = static_cast<size_t>(st.st_size);
+            if (_len != 0)
+                _map = mmap(nullptr, _len, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (_map == MAP_FAILED) {
+                ::close(_fd);
+                throw CSException("invalid checkpoint -- cannot map file");
+            }
+            madvise(_map, _len, MADV_SEQUENTIAL);
+        }
+        ~Mapping() {
+            munmap(_map, _len);
+            ::close(_fd);
+        }
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+
+        const char *data() const { return static_cast<const char *>(_map); }
+        size_t size() const { return _len; }
+    };
+
+    uint64_t Checkpoint::restore(CacheDriver& driver, const char *path) {
+        std::vector<Cache *> caches = driver.caches();
+        std::vector<int> inclusion = inclusions(driver);
+        check_dense(caches);
+        Mapping file(path);
+
+        if (file.size() < sizeof(CheckpointHeader))
+            throw CSException("invalid checkpoint -- file too short");
+        const CheckpointHeader *header = reinterpret_cast<const CheckpointHeader *>(file.data());
+        if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+            throw CSException("invalid checkpoint -- bad magic");
+        if (header->version != CHECKPOINT_VERSION)
+            throw CSException("invalid checkpoint -- unsupported version");
+        if (header->caches != caches.size())
+            throw InvalidConfig("checkpoint has " + std::to_string(header->caches) + " caches, the hierarchy "
+                                + std::to_string(caches.size()));
+
+        /* everything is checked before any cache is touched, a failed restore leaves them as they were */
+        std::vector<const CacheRecord *> records;
+        std::vector<std::vector<const char *>> sources(caches.size());
+        size_t offset = sizeof(CheckpointHeader);
+        for (size_t c = 0; c < caches.size(); c++) {
+            std::string which = "checkpoint cache " + std::to_string(c + 1) + " (" + caches[c]->name() + ")";
+            if (file.size() - offset < sizeof(CacheRecord))
+                throw CSException("invalid checkpoint -- truncated");
+            const CacheRecord *saved = reinterpret_cast<const CacheRecord *>(file.data() + offset);
+            offset += sizeof(CacheRecord);
+            records.push_back(saved);
+
+            std::vector<StateSpan> spans = caches[c]->state();
+            CacheRecord expected = record(*caches[c], inclusion[c], spans.size());
+            if ((saved->classifier == 0) != (expected.classifier == 0))
+                throw InvalidConfig(which + (saved->classifier == 0 ? " was taken with" : " was taken without")
+                                    + " -N, misses are classified in one and not the other");
+            /* the classifier's table has grown with the blocks touched, it's sized as saved on restore */
+            if (expected.classifier != 0) {
+                expected.classifier = saved->classifier;
+                spans.back().bytes = MissClassifier::table_bytes(saved->classifier);
+            }
+            if (memcmp(saved, &expected, sizeof(expected)) != 0)
+                throw InvalidConfig(which + " is a " + std::string(saved->type, strnlen(saved->type, sizeof(saved->type)))
+                                    + " of " + std::to_string(saved->total_size) + "B, "
+                                    + std::to_string(saved->block_size) + "B blocks, "
+                                    + std::to_string(saved->ways) + " ways, "
+                                    + std::string(saved->replacement, strnlen(saved->replacement, sizeof(saved->replacement)))
+                                    + ", " + inclusion_name(static_cast<int>(saved->inclusion))
+                                    + " -- it doesn't match the hierarchy");
+
+            for (auto& span : spans) {
+                if (file.size() - offset < ALIGN)
+                    throw CSException("invalid checkpoint -- truncated");
+                uint64_t bytes;
+                memcpy(&bytes, file.data() + offset, sizeof(bytes));
+                offset += ALIGN;
+                if (bytes != span.bytes)
+                    throw CSException("invalid checkpoint -- state size doesn't match");
+                if (file.size() - offset < padded(span.bytes))
+                    throw CSException("invalid checkpoint -- truncated");
+                sources[c].push_back(file.data() + offset);
+                offset += padded(span.bytes);
+            }
+        }
+        if (offset != file.size())
+            throw CSException("invalid checkpoint -- trailing bytes");
+
+        for (size_t c = 0; c < caches.size(); c++) {
+            if (records[c]->classifier != 0)
+                caches[c]->resize_classifier(records[c]->classifier);
+            std::vector<StateSpan> spans = caches[c]->state();
+            for (size_t s = 0; s < spans.size(); s++)
+                memcpy(spans[s].data, sources[c][s], spans[s].bytes);
+        }
+        return header->position;
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * Checkpoints,
+ * the complete state of a hierarchy at some reference of a trace, saved to skip its warm-up
+ *
+ * layout (host byte order):
+ *
+ *   header, 64 bytes
+ *     char     magic[8]      "CSCHKPT" followed by '\0'
+ *     uint32   version       CHECKPOINT_VERSION
+ *     uint32   caches        number of caches, in CacheDriver::caches() order
+ *     uint64   position      references of the trace simulated before the checkpoint
+ *     reserved, 0
+ *
+ *   for every cache, a 64-byte record followed by its state
+ *     char     type[16]      Cache::type()
+ *     char     replacement[12]
+ *     uint32   inclusion     of the cache's level, nine, inclusive or exclusive
+ *     uint64   total_size
+ *     uint64   block_size
+ *     uint32   sets
+ *     uint32   ways
+ *     uint32   spans         arrays of state that follow, see Cache::state()
+ *     uint32   classifier    log2 of the miss classifier's table entries, 0 if misses aren't classified
+ *     then each array as a uint64 byte count padded to 64 bytes and the bytes padded to 64
+ *
+ * arrays start 64-byte aligned so a restore copies them straight out of the mapped file
+ */
+
+#ifndef CACHE_SIM_CHECKPOINT_HPP
+#define CACHE_SIM_CHECKPOINT_HPP
+
+#include <cstdint>
+
+#include "driver.hpp"
+#include "errors.hpp"
+
+namespace cs {
+
+    const uint32_t CHECKPOINT_VERSION = 5;
+
+    class Checkpoint {
+    public:
+    /*
+     * writes the state of every cache of driver to path, position is where the run is in its trace
+     * throws CSException when path can't be written
+     */
+        static void save(CacheDriver& driver, uint64_t position, const char *path);
+
+    /*
+     * loads the checkpoint at path into driver and returns its position,
+     * the hierarchy must have the geometry, replacement and inclusion policies it was saved from, observers and tracing may differ
+     * throws CSException when the file isn't a checkpoint, InvalidConfig when the hierarchy doesn't match
+     */
+        static uint64_t restore(CacheDriver& driver, const char *path);
+    };
+
+}
+
+#endif //CACHE_SIM_CHECKPOINT_HPP
@@ -0,0 +1,240 @@
+/*
+ * Collectors definition
+ */
+
+#include "collectors.hpp"
+#include <algorithm>
+#include <ios>
+
+namespace cs {
+
+    Collector *Collector::create(const std::string& name) {
+        if (name == "heatmap")
+            return new SetHeatmap();
+        if (name == "regions")
+            return new RegionStats();
+        if (name == "ages")
+            return new EvictionAge();
+        throw InvalidConfig("unknown collector -- heatmap | regions | ages, got " + name);
+    }
+
+    void EventCounts::add(int kind) {
+        switch (kind) {
+            case EVENT_HIT:
+                hits++;
+                break;
+            case EVENT_MISS:
+                misses++;
+                break;
+            case EVENT_EVICT:
+                evictions++;
+                break;
+            case EVENT_WRITEBACK:
+                writebacks++;
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void csv_counts(std::ostream& out, const EventCounts& counts) {
+        out << counts.hits << "," << counts.misses << "," << counts.evictions << "," << counts.writebacks << "\n";
+    }
+
+    static void json_counts(std::ostream& out, const EventCounts& counts) {
+        out << "\"hits\": " << counts.hits << ", \"misses\": " << counts.misses
+            << ", \"evictions\": " << counts.evictions << ", \"writebacks\": " << counts.writebacks;
+    }
+
+    /*
+     * "name": [a, b, ..] of one field of every element
+     */
+    template <typename T, typename Field>
+    static void json_array(std::ostream& out, const char *name, const std::vector<T>& values, Field field) {
+        out << "\"" << name << "\": [";
+        for (size_t i = 0; i < values.size(); i++)
+            out << (i != 0 ? ", " : "") << field(values[i]);
+        out << "]";
+    }
+
+    void SetHeatmap::observe(const Cache& cache, const CacheEvent *events, size_t count) {
+        std::vector<EventCounts>& sets = _sets.of(cache, [](const Cache& c) {
+            return std::vector<EventCounts>(static_cast<size_t>(c.num_sets()), EventCounts{0, 0, 0, 0});
+        });
+        for (size_t i = 0; i < count; i++)
+            sets[static_cast<size_t>(events[i].set)].add(events[i].kind);
+    }
+
+    void SetHeatmap::csv(std::ostream& out) const {
+        out << "cache,set,hits,misses,evictions,writebacks\n";
+        for (auto& state : _sets.states()) {
+            for (size_t set = 0; set < state.second.size(); set++) {
+                out << state.first << "," << set << ",";
+                csv_counts(out, state.second[set]);
+            }
+        }
+    }
+
+    void SetHeatmap::json(std::ostream& out) const {
+        out << "{";
+        const char *sep = "";
+        for (auto& state : _sets.states()) {
+            out << sep << "\"" << state.first << "\": {";
+            json_array(out, "hits", state.second, [](const EventCounts& c) { return c.hits; });
+            out << ", ";
+            json_array(out, "misses", state.second, [](const EventCounts& c) { return c.misses; });
+            out << ", ";
+            json_array(out, "evictions", state.second, [](const EventCounts& c) { return c.evictions; });
+            out << ", ";
+            json_array(out, "writebacks", state.second, [](const EventCounts& c) { return c.writebacks; });
+            out << "}";
+            sep = ", ";
+        }
+        out << "}";
+    }
+
+    RegionStats::RegionStats(size_t region_size) : _shift(0) {
+        if (region_size == 0 || (region_size & (region_size - 1)) != 0)
+            throw InvalidConfig("region size must be a power of two");
+        while ((size_t(1) << _shift) < region_size)
+            _shift++;
+    }
+
+    void RegionStats::observe(const Cache& cache, const CacheEvent *events, size_t count) {
+        std::unordered_map<uint64_t, EventCounts>& regions = _regions.of(cache, [](const Cache&) {
+            return std::unordered_map<uint64_t, EventCounts>();
+        });
+        for (size_t i = 0; i < count; i++) {
+            if (events[i].kind == EVENT_FILL)
+                continue;
+            auto it = regions.emplace(events[i].block >> _shift, EventCounts{0, 0, 0, 0}).first;
+            it->second.add(events[i].kind);
+        }
+    }
+
+    /*
+     * regions of a cache by base address
+     */
+    static std::vector<std::pair<uint64_t, EventCounts>> sorted(const std::unordered_map<uint64_t, EventCounts>& regions) {
+        std::vector<std::pair<uint64_t, EventCounts>> all(regions.begin(), regions.end());
+        std::sort(all.begin(), all.end(), [](const std::pair<uint64_t, EventCounts>& a,
+                                             const std::pair<uint64_t, EventCounts>& b) {
+            return a.first < b.first;
+        });
+        return all;
+    }
+
+    void RegionStats::csv(std::ostream& out) const {
+        out << "cache,region,hits,misses,evictions,writebacks\n";
+        for (auto& state : _regions.states()) {
+            for (auto& region : sorted(state.second)) {
+                out << state.first << "," << std::hex << (region.first << _shift) << std::dec << ",";
+                csv_counts(out, region.second);
+            }
+        }
+    }
+
+    void RegionStats::json(std::ostream& out) const {
+        out << "{";
+        const char *sep = "";
+        for (auto& state : _regions.states()) {
+            out << sep << "\"" << state.first << "\": [";
+            const char *inner = "";
+            for (auto& region : sorted(state.second)) {
+                out << inner << "{\"region\": \"" << std::hex << (region.first << _shift) << std::dec << "\", ";
+                json_counts(out, region.second);
+                out << "}";
+                inner = ", ";
+            }
+            out << "]";
+            sep = ", ";
+        }
+        out << "}";
+    }
+
+    /*
+     * bucket of an age, 0 and 1 share the first one, then one per power of two
+     */
+    static size_t bucket(uint64_t age) {
+        size_t b = 0;
+        while (age > 1) {
+            age >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    void EvictionAge::observe(const Cache& cache, const CacheEvent *events, size_t count) {
+        Ages& ages = _ages.of(cache, [](const Cache&) { return Ages{0, {}, {}, {}}; });
+        for (size_t i = 0; i < count; i++) {
+            const CacheEvent& event = events[i];
+            switch (event.kind) {
+                case EVENT_HIT: {
+                    ages.clock++;
+                    auto it = ages.live.find(event.block);
+                    if (it != ages.live.end())
+                        it->second.hits++;
+                    break;
+                }
+                case EVENT_MISS:
+                    ages.clock++;
+                    break;
+                case EVENT_FILL:
+                    ages.live[event.block] = Life{ages.clock, 0};
+                    break;
+                case EVENT_EVICT: {
+                    auto it = ages.live.find(event.block);
+                    if (it == ages.live.end())
+                        break;
+                    size_t b = bucket(ages.clock - it->second.filled);
+                    if (ages.evictions.size() <= b) {
+                        ages.evictions.resize(b + 1, 0);
+                        ages.dead.resize(b + 1, 0);
+                    }
+                    ages.evictions[b]++;
+                    if (it->second.hits == 0)
+                        ages.dead[b]++;
+                    ages.live.erase(it);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    static uint64_t bucket_age(size_t b) {
+        return b == 0 ? 0 : uint64_t(1) << b;
+    }
+
+    void EvictionAge::csv(std::ostream& out) const {
+        out << "cache,age,evictions,dead\n";
+        for (auto& state : _ages.states()) {
+            for (size_t b = 0; b < state.second.evictions.size(); b++)
+                out << state.first << "," << bucket_age(b) << "," << state.second.evictions[b] << ","
+                    << state.second.dead[b] << "\n";
+        }
+    }
+
+    void EvictionAge::json(std::ostream& out) const {
+        out << "{";
+        const char *sep = "";
+        for (auto& state : _ages.states()) {
+            const Ages& ages = state.second;
+            uint64_t evictions = 0, dead = 0;
+            for (size_t b = 0; b < ages.evictions.size(); b++) {
+                evictions += ages.evictions[b];
+                dead += ages.dead[b];
+            }
+            out << sep << "\"" << state.first << "\": {\"evictions\": " << evictions << ", \"dead\": " << dead
+                << ", \"dead_ratio\": " << (evictions != 0 ? (double) dead / (double) evictions : 0.0)
+                << ", \"ages\": [";
+            for (size_t b = 0; b < ages.evictions.size(); b++)
+                out << (b != 0 ? ", " : "") << "{\"age\": " << bucket_age(b) << ", \"evictions\": "
+                    << ages.evictions[b] << ", \"dead\": " << ages.dead[b] << "}";
+            out << "]}";
+            sep = ", ";
+        }
+        out << "}";
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * Collectors,
+ * built-in observers gathering per-set, per-region and eviction age statistics
+ */
+
+#ifndef CACHE_SIM_COLLECTORS_HPP
+#define CACHE_SIM_COLLECTORS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+#include "observer.hpp"
+
+namespace cs {
+
+/*
+ * hit, miss, eviction and writeback counts of something
+ */
+    struct EventCounts {
+        uint64_t hits, misses, evictions, writebacks;
+
+        void add(int kind);
+    };
+
+/*
+ * per-cache state of a collector, in the order the caches were first seen
+ */
+    template <typename State>
+    class PerCache {
+        std::vector<const Cache *> _caches;
+        std::vector<std::pair<std::string, State>> _states;
+
+    public:
+        /* state of cache, made with make(cache) the first time */
+        template <typename Make>
+        State& of(const Cache& cache, Make make);
+
+        const std::vector<std::pair<std::string, State>>& states() const { return _states; }
+    };
+
+/*
+ * counts per set of every cache, a heatmap of the sets
+ */
+    class SetHeatmap : public Collector {
+        PerCache<std::vector<EventCounts>> _sets;
+
+    public:
+        void observe(const Cache& cache, const CacheEvent *events, size_t count) override;
+        const char *name() const override { return "heatmap"; }
+
+        /* cache,set,hits,misses,evictions,writebacks */
+        void csv(std::ostream& out) const override;
+
+        /* {cache: {hits: [per set], misses: [..], evictions: [..], writebacks: [..]}} */
+        void json(std::ostream& out) const override;
+    };
+
+/*
+ * counts per aligned address region of every cache, e.g. per page
+ */
+    class RegionStats : public Collector {
+        int _shift; /* log2 of the region size */
+        PerCache<std::unordered_map<uint64_t, EventCounts>> _regions;
+
+    public:
+        /* region_size must be a power of two */
+        explicit RegionStats(size_t region_size = 4096);
+
+        void observe(const Cache& cache, const CacheEvent *events, size_t count) override;
+        const char *name() const override { return "regions"; }
+
+        /* cache,region,hits,misses,evictions,writebacks -- regions by base address, ascending */
+        void csv(std::ostream& out) const override;
+
+        /* {cache: [{region, hits, misses, evictions, writebacks}]} */
+        void json(std::ostream& out) const override;
+    };
+
+/*
+ * how long blocks live in every cache, in accesses to that cache from fill to eviction,
+ * in power of two buckets, and how many of them were dead -- evicted without a hit
+ */
+    class EvictionAge : public Collector {
+        struct Life {
+            uint64_t filled; /* clock at the fill */
+            uint64_t hits;
+        };
+
+        struct Ages {
+            uint64_t clock; /* accesses so far */
+            std::unordered_map<uint64_t, Life> live;
+            std::vector<uint64_t> evictions, dead; /* by bucket */
+        };
+
+        PerCache<Ages> _ages;
+
+    public:
+        void observe(const Cache& cache, const CacheEvent *events, size_t count) override;
+        const char *name() const override { return "ages"; }
+
+        /* cache,age,evictions,dead -- age is a bucket's lower bound, buckets go 0, 2, 4, 8 .. */
+        void csv(std::ostream& out) const override;
+
+        /* {cache: {evictions, dead, dead_ratio, ages: [{age, evictions, dead}]}} */
+        void json(std::ostream& out) const override;
+    };
+
+    template <typename State>
+    template <typename Make>
+    State& PerCache<State>::of(const Cache& cache, Make make) {
+        for (size_t i = 0; i < _caches.size(); i++) {
+            if (_caches[i] == &cache)
+                return _states[i].second;
+        }
+        _caches.push_back(&cache);
+        _states.emplace_back(cache.name(), make(cache));
+        return _states.back().second;
+    }
+
+}
+
+#endif //CACHE_SIM_COLLECTORS_HPP
@@ -0,0 +1,256 @@
+/*
+ * Hierarchy configuration file definition
+ */
+
+#include "config_file.hpp"
+#include "replacement.hpp"
+#include <fstream>
+#include <memory>
+
+namespace cs {
+
+    static std::string trim(const std::string& s) {
+        size_t begin = s.find_first_not_of(" \t\r");
+        if (begin == std::string::npos)
+            return "";
+        size_t end = s.find_last_not_of(" \t\r");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    static bool power_of_two(uint64_t n) {
+        return n != 0 && (n & (n - 1)) == 0;
+    }
+
+    static int log2_of(uint64_t n) {
+        int bits = 0;
+        while ((uint64_t(1) << bits) < n)
+            bits++;
+        return bits;
+    }
+
+    /*
+     * error at line `line' of file `name'
+     */
+    static InvalidConfig error(const std::string& name, size_t line, const std::string& message) {
+        return InvalidConfig(name + ":" + std::to_string(line) + ": " + message);
+    }
+
+    /*
+     * a positive number, or 0 too if zero is set, sizes may carry a K, M or G suffix
+     */
+    static uint64_t number(const std::string& value, bool suffix, const std::string& name, size_t line,
+                           bool zero = false) {
+        size_t used = 0;
+        unsigned long long n = 0;
+        try {
+            if (!value.empty() && value[0] != '-')
+                n = std::stoull(value, &used);
+        } catch (std::exception&) {
+            used = 0;
+        }
+        if (suffix && used != 0 && used + 1 == value.size()) {
+            switch (value[used]) {
+                case 'k': case 'K': n <<= 10; used++; break;
+                case 'm': case 'M': n <<= 20; used++; break;
+                case 'g': case 'G': n <<= 30; used++; break;
+                default: break;
+            }
+        }
+        if (used == 0 || used != value.size() || (n == 0 && !zero))
+            throw error(name, line, "invalid number -- " + value);
+        return n;
+    }
+
+    /*
+     * a latency in cycles, 0 included
+     */
+    static int cycles(const std::string& value, const std::string& name, size_t line) {
+        uint64_t n = number(value, false, name, line, true);
+        if (n > static_cast<uint64_t>(INT32_MAX))
+            throw error(name, line, "too many cycles -- " + value);
+        return static_cast<int>(n);
+    }
+
+    static int write_policy(const std::string& value, const std::string& name, size_t line) {
+        if (value == "wb")
+            return write_back;
+        if (value == "wt")
+            return write_through;
+        throw error(name, line, "invalid write policy -- wb | wt, got " + value);
+    }
+
+    ConfigFile::ConfigFile(const char *path) {
+        std::ifstream in(path);
+        if (!in.is_open())
+            throw InvalidConfig(std::string("cannot open configuration file ") + path);
+        parse(in, path);
+    }
+
+    ConfigFile::ConfigFile(std::istream& in, const std::string& name) {
+        parse(in, name);
+    }
+
+    void ConfigFile::parse(std::istream& in, const std::string& name) {
+        /* where each level was declared, for errors about the level as a whole */
+        std::vector<std::vector<size_t>> declared;
+        /* keys seen in the current level, required ones are checked when it ends */
+        bool has_data = false, has_size = false, has_block = false, has_assoc = false;
+        bool in_level = false, implicit = false;
+
+        auto close_level = [&](size_t line) {
+            if (!in_level)
+                return;
+            if (!has_data || !has_size || !has_block || !has_assoc)
+                throw error(name, line, "level needs data, size, block and associativity");
+            in_level = false;
+        };
+
+        std::string text;
+        size_t line = 0;
+        while (std::getline(in, text)) {
+            line++;
+            size_t comment = text.find_first_of("#;");
+            if (comment != std::string::npos)
+                text.erase(comment);
+            text = trim(text);
+            if (text.empty())
+                continue;
+
+            if (text[0] == '[') {
+                if (text.back() != ']')
+                    throw error(name, line, "unterminated section -- " + text);
+                std::string section = trim(text.substr(1, text.size() - 2));
+                close_level(declared.empty() || declared.back().empty() ? line : declared.back().back());
+
+                if (section == "level") {
+                    if (_hierarchies.empty()) {
+                        implicit = true;
+                        _names.push_back("default");
+                        _hierarchies.emplace_back();
+                        declared.emplace_back();
+                    }
+                    _hierarchies.back().push_back(config{0, 0, 0, 0, 32, 1, 100, 0, "lru", nine, false});
+                    declared.back().push_back(line);
+                    has_data = has_size = has_block = has_assoc = false;
+                    in_level = true;
+                } else if (section.compare(0, 9, "hierarchy") == 0
+                           && (section.size() == 9 || section[9] == ' ' || section[9] == '\t')) {
+                    std::string variant = trim(section.substr(9));
+                    if (variant.empty())
+                        variant = "hierarchy" + std::to_string(_hierarchies.size() + 1);
+                    if (implicit)
+                        throw error(name, line, "levels outside of a hierarchy section");
+                    for (auto& other : _names) {
+                        if (other == variant)
+                            throw error(name, line, "duplicate hierarchy " + variant);
+                    }
+                    _names.push_back(variant);
+                    _hierarchies.emplace_back();
+                    declared.emplace_back();
+                } else {
+                    throw error(name, line, "unknown section -- " + section);
+                }
+                continue;
+            }
+
+            size_t eq = text.find('=');
+            if (eq == std::string::npos)
+                throw error(name, line, "expected key = value, got " + text);
+            std::string key = trim(text.substr(0, eq));
+            std::string value = trim(text.substr(eq + 1));
+            if (!in_level)
+                throw error(name, line, "key outside of a level section -- " + key);
+            if (value.empty())
+                throw error(name, line, "no value for " + key);
+
+            config& level = _hierarchies.back().back();
+            if (key == "instruction") {
+                level.instruction = write_policy(value, name, line);
+            } else if (key == "data") {
+                level.data = write_policy(value, name, line);
+                has_data = true;
+            } else if (key == "size") {
+                level.total_size = number(value, true, name, line);
+                has_size = true;
+            } else if (key == "block") {
+                level.block_size = number(value, true, name, line);
+                has_block = true;
+            } else if (key == "associativity") {
+                uint64_t ways = number(value, false, name, line);
+                if (ways > static_cast<uint64_t>(INT32_MAX))
+                    throw error(name, line, "associativity too large -- " + value);
+                level.blocks_per_set = static_cast<int>(ways);
+                has_assoc = true;
+            } else if (key == "hit_time") {
+                level.hit_time = cycles(value, name, line);
+            } else if (key == "miss_penalty") {
+                level.miss_penalty = cycles(value, name, line);
+            } else if (key == "address_size") {
+                level.address_size = number(value, false, name, line);
+                if (level.address_size > 64)
+                    throw error(name, line, "address size is at most 64 bits");
+            } else if (key == "replacement") {
+                level.replacement = value;
+            } else if (key == "store") {
+                if (value == "sparse")
+                    level.sparse = true;
+                else if (value == "dense")
+                    level.sparse = false;
+                else
+                    throw error(name, line, "unknown store -- " + value + ", dense | sparse");
+            } else if (key == "inclusion") {
+                try {
+                    level.inclusion = inclusion_policy(value);
+                } catch (InvalidConfig& ex) {
+                    throw error(name, line, ex.what());
+                }
+            } else {
+                throw error(name, line, "unknown key -- " + key);
+            }
+        }
+        close_level(line);
+
+        if (_hierarchies.empty())
+            throw InvalidConfig(name + ": no levels");
+
+        /*
+         * everything the simulator would reject, checked before anything runs
+         */
+        for (size_t h = 0; h < _hierarchies.size(); h++) {
+            if (_hierarchies[h].empty())
+                throw InvalidConfig(name + ": hierarchy " + _names[h] + " has no levels");
+
+            for (size_t l = 0; l < _hierarchies[h].size(); l++) {
+                const config& level = _hierarchies[h][l];
+                size_t at = declared[h][l];
+                uint64_t set_bytes = uint64_t(level.block_size) * level.blocks_per_set;
+
+                if (!power_of_two(level.block_size))
+                    throw error(name, at, "block size must be a power of two");
+                if (level.total_size % set_bytes != 0)
+                    throw error(name, at, "size must be a multiple of block * associativity");
+                uint64_t sets = level.total_size / set_bytes;
+                if (!power_of_two(sets))
+                    throw error(name, at, "number of sets (size / (block * associativity)) must be a power of two");
+                if (sets > static_cast<uint64_t>(AddressTranslator::MAX_SETS))
+                    throw error(name, at, "at most 2^30 sets");
+                if (static_cast<int>(level.address_size) <= log2_of(level.block_size) + log2_of(sets))
+                    throw error(name, at, "address size leaves no tag bits");
+                if (static_cast<int>(level.address_size) - log2_of(level.block_size) - log2_of(sets) >= 64)
+                    throw error(name, at, "tags are at most 63 bits, a 64-bit address needs more than one block or set");
+
+                try {
+                    std::unique_ptr<ReplacementPolicy> policy(
+                            ReplacementPolicy::create(level.replacement, 1, level.blocks_per_set));
+                } catch (CSException& ex) {
+                    throw error(name, at, ex.what());
+                }
+
+                if (l == 0 && level.inclusion != nine)
+                    throw error(name, at, "level 1 cannot be inclusive or exclusive, there is nothing above it");
+                if (l > 0 && level.inclusion == exclusive && _hierarchies[h][l - 1].block_size != level.block_size)
+                    throw error(name, at, "exclusive level needs the block size of the level above");
+            }
+        }
+    }
+}
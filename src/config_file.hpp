@@ -0,0 +1,78 @@
+/*
+ * Hierarchy configuration files
+ *
+ * an INI style description of one or more hierarchies, e.g.
+ *
+ *   # L1 split, L2 unified
+ *   [hierarchy small]
+ *   [level]
+ *   instruction = wb
+ *   data = wb
+ *   size = 1K
+ *   block = 32
+ *   associativity = 2
+ *   [level]
+ *   data = wb
+ *   size = 16K
+ *   block = 128
+ *   associativity = 4
+ *   inclusion = inclusive
+ *
+ * every [hierarchy name] section starts a variant and the [level] sections
+ * after it are its levels, top to bottom; a file without [hierarchy] sections
+ * is a single hierarchy named "default"
+ *
+ * level keys:
+ *   instruction    wb | wt, splits the level into instruction and data caches
+ *   data           wb | wt, the data or unified cache, required
+ *   size, block    bytes, with an optional K, M or G suffix, required
+ *   associativity  blocks per set, required
+ *   hit_time       cycles, 0 or more, defaults to 1
+ *   miss_penalty   cycles, 0 or more, defaults to 100
+ *   address_size   bits, defaults to 32
+ *   replacement    lru | plru | srrip | random | fifo | lfu, defaults to lru
+ *   inclusion      nine | inclusive | exclusive, defaults to nine
+ *   store          dense | sparse, sparse keeps tags only for the sets touched, defaults to dense
+ *
+ * comments start with # or ; and run to the end of the line
+ */
+
+#ifndef CACHE_SIM_CONFIG_FILE_HPP
+#define CACHE_SIM_CONFIG_FILE_HPP
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+#include "errors.hpp"
+
+namespace cs {
+
+    class ConfigFile {
+        std::vector<std::string> _names;
+        std::vector<std::vector<config>> _hierarchies;
+
+    public:
+    /*
+     * reads and validates every hierarchy of the file at path,
+     * throws InvalidConfig naming the file and line of the first problem
+     */
+        explicit ConfigFile(const char *path);
+
+    /*
+     * same for a stream, `name' is used in error messages
+     */
+        ConfigFile(std::istream& in, const std::string& name);
+
+        const std::vector<std::string>& names() const { return _names; }
+        const std::vector<std::vector<config>>& hierarchies() const { return _hierarchies; }
+        size_t size() const { return _hierarchies.size(); }
+
+    private:
+        void parse(std::istream& in, const std::string& name);
+    };
+
+}
+
+#endif //CACHE_SIM_CONFIG_FILE_HPP
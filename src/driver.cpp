@@ -3,167 +3,387 @@
  * Author: Parsa Bagheri
  */
 #include <iostream>
+#include <algorithm>
+#include <exception>
+#include <thread>
 #include "driver.hpp"
 #include "errors.hpp"
 
 namespace cs {
 
-    int CacheDriver::L1::exec(int instruction, std::string address) {
-        int retval = MISS;
-        switch (instruction) {
-            case INSTRUCTION_READ:
-                retval = i_cache->read(address.c_str());
-                break;
-            case DATA_READ:
-                retval = d_cache->read(address.c_str());
-                break;
-            case DATA_WRITE:
-                retval = d_cache->write(address.c_str());
-                break;
-            default:
-                throw CSException("unknown memory reference");
+    int inclusion_policy(const std::string& name) {
+        if (name == "nine")
+            return nine;
+        if (name == "inclusive")
+            return inclusive;
+        if (name == "exclusive")
+            return exclusive;
+        throw InvalidConfig("unknown inclusion policy -- nine | inclusive | exclusive, got " + name);
+    }
 
+    const char *inclusion_name(int inclusion) {
+        switch (inclusion) {
+            case inclusive:
+                return "inclusive";
+            case exclusive:
+                return "exclusive";
+            default:
+                return "nine";
         }
-        return retval;
     }
 
+    CacheDriver::Level::Level(config& configuration)
+            : i_cache(nullptr), d_cache(nullptr), _hit_time(configuration.hit_time),
+              _miss_penalty(configuration.miss_penalty), _inclusion(configuration.inclusion) {
+        if (configuration.data == 0)
+            throw CSException("data cache type is not specified -- write_through or write_back");
+        if (_inclusion != nine && _inclusion != inclusive && _inclusion != exclusive)
+            throw InvalidConfig("unknown inclusion policy");
 
-    double CacheDriver::L1::hit_plus_missrate() {
-        double i_hits = i_cache->get_hits();
-        double i_misses = i_cache->get_misses();
-        double d_hits = d_cache->get_hits();
-        double d_misses = d_cache->get_misses();
-        double total = i_hits + d_hits + i_misses + d_misses;
-        double miss_rate = (i_misses + d_misses)/total;
-        return _hit_time + miss_rate;
-    }
-
-    void CacheDriver::L1::summary(std::ostream &out) {
-        out << "instruction cache summary:\n";
-        this->i_cache->summary(out);
-        out << "data cache summary:\n";
-        this->d_cache->summary(out);
-        out << "\n";
+        d_cache = CacheDriver::create(configuration.data, configuration);
+        if (configuration.instruction != 0) {
+            try {
+                i_cache = CacheDriver::create(configuration.instruction, configuration);
+            } catch (...) {
+                delete d_cache;
+                throw;
+            }
+        }
     }
 
-    CacheDriver::L1::~L1() {
+    CacheDriver::Level::~Level() {
         delete i_cache;
         delete d_cache;
     }
 
-    CacheDriver::L1::L1(config& configuration)
-            : _hit_time(configuration.hit_time), _miss_penalty(configuration.miss_penalty), _debug(configuration.debug) {
-        if (configuration.instruction == 0 || configuration.data == 0) {
-            throw CSException("instruction or data caches type is not specified -- write_through or write_back");
+    size_t CacheDriver::Level::exec_batch(const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses) {
+        if (i_cache == nullptr)
+            return d_cache->exec_batch(refs, idx, count, misses);
 
-        } else {
-            init(configuration.data, configuration, &d_cache);
-            init(configuration.instruction, configuration, &i_cache);
+        if (_i_idx.size() < count) {
+            _i_idx.resize(count);
+            _d_idx.resize(count);
+            _i_misses.resize(count);
+            _d_misses.resize(count);
+        }
+
+        size_t ni = 0, nd = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (refs[idx[i]].type == INSTRUCTION_READ)
+                _i_idx[ni++] = idx[i];
+            else
+                _d_idx[nd++] = idx[i];
+        }
+
+        size_t mi = i_cache->exec_batch(refs, _i_idx.data(), ni, _i_misses.data());
+        size_t md = d_cache->exec_batch(refs, _d_idx.data(), nd, _d_misses.data());
+
+        /* both halves are in reference order, merge them back into one stream */
+        return std::merge(_i_misses.begin(), _i_misses.begin() + mi,
+                          _d_misses.begin(), _d_misses.begin() + md, misses) - misses;
+    }
+
+    std::vector<Writeback>& CacheDriver::Level::writebacks() {
+        if (i_cache == nullptr || i_cache->writebacks().empty())
+            return d_cache->writebacks();
+
+        std::vector<Writeback>& i = i_cache->writebacks();
+        std::vector<Writeback>& d = d_cache->writebacks();
+        _writebacks.resize(i.size() + d.size());
+        std::merge(i.begin(), i.end(), d.begin(), d.end(), _writebacks.begin(),
+                   [](const Writeback& a, const Writeback& b) { return a.at < b.at; });
+        i.clear();
+        d.clear();
+        return _writebacks;
+    }
+
+    double CacheDriver::Level::miss_rate() {
+        double hits = d_cache->get_hits();
+        double misses = d_cache->get_misses();
+        if (i_cache != nullptr) {
+            hits += i_cache->get_hits();
+            misses += i_cache->get_misses();
+        }
+        if (hits + misses == 0)
+            return 0.0;
+        return misses/(hits + misses);
+    }
+
+    void CacheDriver::Level::summary(std::ostream &out) {
+        if (i_cache == nullptr) {
+            d_cache->summary(out);
+            return;
+        }
+        out << "instruction cache summary:\n";
+        i_cache->summary(out);
+        out << "data cache summary:\n";
+        d_cache->summary(out);
+        if (i_cache->classifying() && d_cache->classifying()) {
+            const CacheStats& i = i_cache->stats();
+            const CacheStats& d = d_cache->stats();
+            out << "misses of the level: " << i.compulsory + d.compulsory << " compulsory, "
+                << i.capacity + d.capacity << " capacity, " << i.conflict + d.conflict << " conflict\n";
         }
+        out << "\n";
     }
 
-    void CacheDriver::L1::init (int conf, config& configuration, Cache **cache) {
-        switch (conf) {
+    Cache *CacheDriver::create (int type, config& configuration) {
+        std::string replacement = configuration.replacement.empty() ? "lru" : configuration.replacement;
+        switch (type) {
             case write_back:
-                *cache = new cs::WriteBack(configuration.total_size, configuration.block_size,
-                                           configuration.address_size, configuration.blocks_per_set,
-                                           configuration.hit_time, configuration.miss_penalty,
-                                           nullptr, configuration.debug);
-                break;
+                return new cs::WriteBack(configuration.total_size, configuration.block_size,
+                                         configuration.address_size, configuration.blocks_per_set,
+                                         configuration.hit_time, configuration.miss_penalty,
+                                         nullptr, replacement, configuration.sparse);
             case write_through:
-                *cache = new cs::WriteThrough(configuration.total_size, configuration.block_size,
-                                              configuration.address_size, configuration.blocks_per_set,
-                                              configuration.hit_time, configuration.miss_penalty,
-                                              nullptr, configuration.debug);
-                break;
+                return new cs::WriteThrough(configuration.total_size, configuration.block_size,
+                                            configuration.address_size, configuration.blocks_per_set,
+                                            configuration.hit_time, configuration.miss_penalty,
+                                            nullptr, replacement, configuration.sparse);
             default:
                 throw CSException("unknown configuration");
         }
     }
 
-    CacheDriver::L2::L2(config &configuration)
-            : _hit_time(configuration.hit_time), _miss_penalty(configuration.miss_penalty) {
-        if (configuration.instruction != 0 && configuration.data != 0) {
-            throw CSException("Level 2 cache cannot have instruction or data sub-caches");
+    CacheDriver::CacheDriver (std::vector<config>& configurations) : _nine(true), _observed(false), _address_size(64) {
+        if (configurations.empty())
+            throw InvalidConfig("a hierarchy needs at least one level");
 
-        } else {
-            CacheDriver::L1::init(configuration.data, configuration, &cache);
+        try {
+            for (auto & configuration : configurations) {
+                size_t l = _levels.size();
+                if (l == 0 && configuration.inclusion != nine)
+                    throw InvalidConfig("level 1 cannot be inclusive or exclusive, there is nothing above it");
+                if (configuration.inclusion == exclusive && configurations[l - 1].block_size != configuration.block_size)
+                    throw InvalidConfig("level " + std::to_string(l + 1)
+                                        + " is exclusive, its block size must match the level above");
+                if (configuration.address_size < _address_size)
+                    _address_size = configuration.address_size;
+                if (configuration.inclusion != nine)
+                    _nine = false;
+                _levels.push_back(new Level(configuration));
+            }
+        } catch (...) {
+            for (auto level : _levels)
+                delete level;
+            throw;
+        }
+
+        /*
+         * inclusion is enforced on evictions, have every cache report them,
+         * otherwise dirty blocks are logged for the level below, the last level's go to memory
+         */
+        for (size_t l = 0; l < _levels.size(); l++) {
+            std::string name = "L" + std::to_string(l + 1);
+            if (_levels[l]->i_cache != nullptr) {
+                _levels[l]->i_cache->set_name(name + "i");
+                _levels[l]->d_cache->set_name(name + "d");
+            } else {
+                _levels[l]->d_cache->set_name(name);
+            }
+            for (auto cache : {_levels[l]->i_cache, _levels[l]->d_cache}) {
+                if (cache == nullptr)
+                    continue;
+                if (!_nine)
+                    cache->track_evictions(true);
+                else if (l + 1 < _levels.size())
+                    cache->log_writebacks(true);
+            }
+        }
+    }
+
+    CacheDriver::~CacheDriver() {
+        for (auto i : _levels) {
+            delete i;
         }
+        _levels.clear();
     }
 
-    CacheDriver::L2::~L2() {
-        delete cache;
+    int CacheDriver::exec(int instruction, uint64_t address) {
+        Reference ref = {address, instruction, 0};
+        return exec(&ref, 1) == 0 ? HIT : MISS;
     }
 
-    int CacheDriver::L2::exec(int instruction, std::string address) {
-        int retval = MISS;
-        switch (instruction) {
-            case INSTRUCTION_READ:
-                retval = cache->read(address.c_str());
-                break;
-            case DATA_READ:
-                retval = cache->read(address.c_str());
-                break;
-            case DATA_WRITE:
-                retval = cache->write(address.c_str());
-                break;
-            default:
-                throw CSException("unknown memory reference");
+    size_t CacheDriver::exec(const Reference *refs, size_t count) {
+        check(refs, count);
+
+        size_t missed = 0;
+        if (!_nine) {
+            for (size_t r = 0; r < count; r++) {
+                if (access(refs[r]) == MISS)
+                    missed++;
+            }
+        } else {
+            missed = run(refs, count, _levels.size(), nullptr);
+        }
+        if (_observed) {
+            for (auto cache : caches())
+                cache->flush_events();
         }
-        return retval;
+        return missed;
     }
 
-    void CacheDriver::L2::summary(std::ostream &out) {
-        this->cache->summary(out);
+    size_t CacheDriver::run(const Reference *refs, size_t count, size_t depth, std::vector<Reference> *below) {
+        /* chunks keep the index buffers small enough to stay in cache */
+        static const size_t CHUNK = 4096;
+
+        size_t missed = 0;
+        for (size_t begin = 0; begin < count; begin += CHUNK) {
+            size_t n = count - begin < CHUNK ? count - begin : CHUNK;
+            const Reference *cur = refs + begin;
+            bool staged = false; /* cur holds writebacks as well as references */
+            if (_idx.size() < n) {
+                _idx.resize(n);
+                _misses.resize(n);
+            }
+            for (size_t i = 0; i < n; i++)
+                _idx[i] = static_cast<uint32_t>(i);
+
+            /* going through every level, only the misses go on to the next one */
+            for (size_t l = 0; l < depth && n != 0; l++) {
+                Level *level = _levels[l];
+                n = level->exec_batch(cur, _idx.data(), n, _misses.data());
+
+                std::vector<Writeback>& writebacks = level->writebacks();
+                bool writes_back = level->d_cache->writes_back();
+                if (writebacks.empty() && !writes_back) {
+                    _idx.swap(_misses);
+                    continue;
+                }
+
+                /*
+                 * a write-back level fetches the blocks its writes missed with reads
+                 * and keeps the blocks written back to it, what it passes on is staged,
+                 * each of its own writebacks right after the miss that evicted it
+                 */
+                std::vector<Reference>& next = _staged[l % 2];
+                next.clear();
+                size_t w = 0;
+                for (size_t i = 0; i < n; i++) {
+                    Reference ref = cur[_misses[i]];
+                    /* a writeback it missed is kept here, but what it evicted goes on all the same */
+                    if (!writes_back || ref.type != WRITEBACK) {
+                        if (writes_back && ref.type == DATA_WRITE)
+                            ref.type = DATA_READ;
+                        next.push_back(ref);
+                    }
+                    for (; w < writebacks.size() && writebacks[w].at == _misses[i]; w++)
+                        next.push_back(Reference{writebacks[w].address, WRITEBACK, 0});
+                }
+                for (; w < writebacks.size(); w++)
+                    next.push_back(Reference{writebacks[w].address, WRITEBACK, 0});
+                writebacks.clear();
+
+                cur = next.data();
+                staged = true;
+                n = next.size();
+                if (_idx.size() < n) {
+                    _idx.resize(n);
+                    _misses.resize(n);
+                }
+                for (size_t i = 0; i < n; i++)
+                    _idx[i] = static_cast<uint32_t>(i);
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                const Reference& ref = cur[_idx[i]];
+                if (below != nullptr)
+                    below->push_back(ref);
+                if (!staged || ref.type != WRITEBACK)
+                    missed++;
+            }
+        }
+        return missed;
     }
 
-    double CacheDriver::L2::hit_plus_missrate() {
-        double hits = cache->get_hits();
-        double misses = cache->get_misses();
-        return 10 * _hit_time + 10 * (misses/(hits + misses));
+    void CacheDriver::check(const Reference *refs, size_t count) const {
+        for (size_t r = 0; r < count; r++) {
+            if (refs[r].type != INSTRUCTION_READ && refs[r].type != DATA_READ && refs[r].type != DATA_WRITE)
+                throw CSException("unknown memory reference");
+            if (_address_size < 64 && (refs[r].address >> _address_size) != 0)
+                throw AddressTranslation();
+        }
     }
 
-    CacheDriver::CacheDriver (std::vector<config>& configurations) {
-        int i = 0;
-        for (auto & configuration : configurations) {
-            if (i == 0) {
-                _levels.push_back(new L1(configuration));
-            } else if (i == 1) {
-                _levels.push_back(new L2(configuration));
+    int CacheDriver::access(const Reference& ref) {
+        int type = ref.type;
+        for (size_t l = 0; l < _levels.size(); l++) {
+            Level *level = _levels[l];
+            Cache *cache = level->cache_for(type);
+            int result;
+            if (level->_inclusion == exclusive) {
+                /* a hit moves the block up, to the line the level above just filled */
+                bool dirty;
+                result = cache->probe(ref.address, true, dirty);
+                if (dirty)
+                    _levels[l - 1]->cache_for(type)->mark_dirty(ref.address);
+            } else if (is_write(type)) {
+                result = cache->write(ref.address);
             } else {
-                throw CSException("no support for more than 2 levels");
+                result = cache->read(ref.address);
             }
-            i++;
+
+            settle(l, cache);
+            if (result == HIT)
+                return HIT;
+            /* a write-back level fetches the block it's writing with a read */
+            if (type == DATA_WRITE && cache->writes_back())
+                type = DATA_READ;
         }
+        return MISS;
     }
 
-    CacheDriver::~CacheDriver() {
-        for (auto i : _levels) {
-            delete i;
+    void CacheDriver::settle(size_t level, Cache *cache) {
+        uint64_t victim;
+        bool dirty;
+        if (cache->evicted(victim, dirty))
+            evicted(level, cache == _levels[level]->i_cache ? INSTRUCTION_READ : DATA_READ, victim, dirty);
+    }
+
+    void CacheDriver::evicted(size_t level, int instruction, uint64_t victim, bool dirty) {
+        if (_levels[level]->_inclusion == inclusive) {
+            /* back-invalidation, a copy dirty above makes the victim dirty, its data goes down with it */
+            size_t bytes = _levels[level]->d_cache->block_size();
+            for (size_t l = 0; l < level; l++) {
+                if (_levels[l]->i_cache != nullptr)
+                    dirty |= _levels[l]->i_cache->invalidate_range(victim, bytes);
+                dirty |= _levels[l]->d_cache->invalidate_range(victim, bytes);
+            }
+        }
+
+        if (level + 1 == _levels.size())
+            return;
+        if (_levels[level + 1]->_inclusion == exclusive) {
+            Cache *below = _levels[level + 1]->cache_for(instruction);
+            below->fill(victim, dirty);
+            settle(level + 1, below);
+        } else if (dirty) {
+            writeback(level + 1, victim);
         }
-        _levels.clear();
     }
 
-    int CacheDriver::exec(int instruction, std::string address) {
-        /* going through every level, breaking once we have a hit */
-        int retval = MISS;
-        for (auto i : _levels) {
-            retval = i->exec(instruction, address);
-            if ( retval == HIT )
-                break;
+    void CacheDriver::writeback(size_t level, uint64_t block) {
+        for (; level < _levels.size(); level++) {
+            Cache *cache = _levels[level]->d_cache;
+            int result = HIT;
+            if (_levels[level]->_inclusion == exclusive)
+                cache->fill(block, true);
+            else
+                result = cache->write(block);
+            settle(level, cache);
+            if (result == HIT || cache->writes_back())
+                return;
         }
-        return retval;
+    }
+
+    double CacheDriver::amat(size_t level) {
+        Level *l = _levels[level];
+        double below = level + 1 == _levels.size() ? l->_miss_penalty : amat(level + 1);
+        return l->_hit_time + l->miss_rate() * below;
     }
 
     double CacheDriver::AMAT () {
-        switch (_levels.size()) {
-            case 1:
-                return l1_amat();
-            case 2:
-                return l2_amat();
-            default:
-                throw CSException("no support for levels beyond 2");
-        }
+        return amat(0);
     }
 
     void CacheDriver::summary(std::ostream &out) {
@@ -176,26 +396,128 @@ namespace cs {
         out << "overall average memory access time: " << AMAT() << "\n";
     }
 
-    double CacheDriver::l1_amat() {
-        L1 *l1 = dynamic_cast<L1 *>(_levels[0]);
-        double i_hits = l1->i_cache->get_hits();
-        double i_misses = l1->i_cache->get_misses();
-        double d_hits = l1->d_cache->get_hits();
-        double d_misses = l1->d_cache->get_misses();
-        double total = i_hits + d_hits + i_misses + d_misses;
-        double miss_rate = (i_misses + d_misses)/total;
-        return l1->_hit_time + miss_rate * l1->_miss_penalty;
-    }
-
-    double CacheDriver::l2_amat() {
-        L1 *l1 = dynamic_cast<L1 *>(_levels[0]);
-        double i_hits = l1->i_cache->get_hits();
-        double i_misses = l1->i_cache->get_misses();
-        double d_hits = l1->d_cache->get_hits();
-        double d_misses = l1->d_cache->get_misses();
-        double l1_miss_rate = (i_misses + d_misses)/(i_misses + d_misses + i_hits + d_hits);
-        L2 *l2 = dynamic_cast<L2 *>(_levels[1]);
-        double l2_miss_rate = l2->cache->get_miss_rate();
-        return l1->_hit_time + l1_miss_rate * (l2->_hit_time + l2_miss_rate * l2->_miss_penalty);
-    }
-}
\ No newline at end of file
+    std::vector<Cache *> CacheDriver::caches() {
+        std::vector<Cache *> all;
+        for (size_t l = 0; l < _levels.size(); l++) {
+            for (auto cache : caches(l))
+                all.push_back(cache);
+        }
+        return all;
+    }
+
+    std::vector<Cache *> CacheDriver::caches(size_t level) {
+        if (_levels[level]->i_cache != nullptr)
+            return {_levels[level]->i_cache, _levels[level]->d_cache};
+        return {_levels[level]->d_cache};
+    }
+
+    void CacheDriver::trace(TraceSink *sink) {
+        for (auto cache : caches())
+            cache->trace(sink);
+    }
+
+    void CacheDriver::classify(bool on) {
+        for (auto cache : caches())
+            cache->classify(on);
+    }
+
+    void CacheDriver::observe(CacheObserver *observer) {
+        for (auto cache : caches())
+            cache->observe(observer);
+        _observed = true;
+    }
+
+    void CacheDriver::warm(const Reference *refs, size_t count) {
+        std::vector<Cache *> all = caches();
+        for (auto cache : all)
+            cache->warm(true);
+        try {
+            (void) exec(refs, count);
+        } catch (...) {
+            for (auto cache : all)
+                cache->warm(false);
+            throw;
+        }
+        for (auto cache : all)
+            cache->warm(false);
+    }
+
+    void CacheDriver::exec_partitioned(const Reference *refs, size_t count, int threads) {
+        if (!_nine)
+            throw CSException("partitioned runs need every level to be non-inclusive non-exclusive");
+        if (_observed)
+            throw CSException("observed caches can't be partitioned across threads");
+        for (auto cache : {_levels.back()->i_cache, _levels.back()->d_cache}) {
+            if (cache != nullptr && cache->sparse())
+                throw CSException("a sparse last level can't be partitioned across threads, it grows as sets are touched");
+        }
+        check(refs, count);
+        if (threads <= 0)
+            threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (threads <= 0)
+            threads = 1;
+
+        /* upper levels run in order, the last level only sees what missed all of them, and their writebacks */
+        std::vector<Reference> filtered;
+        if (_levels.size() > 1) {
+            (void) run(refs, count, _levels.size() - 1, &filtered);
+            refs = filtered.data();
+            count = filtered.size();
+        }
+
+        /*
+         * bucket the references by set, in runs of 8 sets so that
+         * no two workers share a cache line of the tag store
+         */
+        std::vector<std::vector<Reference>> buckets(threads);
+        for (auto& bucket : buckets)
+            bucket.reserve(count / threads + 1);
+        Level *last_level = _levels.back();
+        for (size_t r = 0; r < count; r++) {
+            int set = last_level->cache_for(refs[r].type)->set_of(refs[r].address);
+            buckets[(set >> 3) % threads].push_back(refs[r]);
+        }
+
+        /* counters of the last level's data (or unified) cache at index 0, instruction cache at 1 */
+        std::vector<Cache *> last = {last_level->d_cache};
+        if (last_level->i_cache != nullptr)
+            last.push_back(last_level->i_cache);
+        /* the classifier sees every set of a cache, the workers only share its counters */
+        for (auto cache : last)
+            cache->classify(false);
+        std::vector<std::vector<CacheStats>> stats(threads, std::vector<CacheStats>(last.size(), CacheStats{0, 0, 0, 0, 0, 0}));
+        std::vector<std::exception_ptr> errors(threads);
+
+        auto worker = [&](int w) {
+            try {
+                for (auto& ref : buckets[w]) {
+                    Cache *cache = last_level->cache_for(ref.type);
+                    size_t index = cache == last_level->d_cache ? 0 : 1;
+                    if (is_write(ref.type))
+                        (void) cache->write(ref.address, stats[w][index]);
+                    else
+                        (void) cache->read(ref.address, stats[w][index]);
+                }
+            } catch (...) {
+                errors[w] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (int w = 1; w < threads; w++)
+            pool.emplace_back(worker, w);
+        worker(0);
+        for (auto& thread : pool)
+            thread.join();
+
+        for (auto& error : errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        for (int w = 0; w < threads; w++) {
+            for (size_t index = 0; index < last.size(); index++)
+                last[index]->add_stats(stats[w][index]);
+        }
+    }
+}
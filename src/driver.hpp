@@ -1,5 +1,5 @@
 /*
- * L1 classes for different cache systems
+ * cache hierarchy driver
  * Author: Parsa Bagheri
  */
 
@@ -8,8 +8,9 @@
 
 #include <ostream>
 #include <vector>
-#include <array>
+#include <string>
 #include "cache.hpp"
+#include "reference.hpp"
 
 namespace cs {
 
@@ -18,12 +19,27 @@ namespace cs {
         write_through
     };
 
+    /*
+     * how a level relates to the levels above it
+     */
+    enum inclusion_type {
+        nine, /* non-inclusive non-exclusive -- every level fills on a miss, independently */
+        inclusive, /* holds everything above it, its evictions invalidate the levels above */
+        exclusive /* holds only what isn't above it, filled with the victims of the level above */
+    };
+
+    /*
+     * inclusion policy by name -- nine | inclusive | exclusive, throws InvalidConfig otherwise
+     */
+    int inclusion_policy(const std::string& name);
+    const char *inclusion_name(int inclusion);
+
     /*
      * configuration struct
      * used to configure one single cache
      */
     struct config {
-        int instruction; /* write_back or write_through */
+        int instruction; /* write_back or write_through, 0 for a unified level */
         int data; /* write_back or write_through */
         size_t total_size;
         size_t block_size;
@@ -31,18 +47,14 @@ namespace cs {
         int hit_time;
         int miss_penalty;
         int blocks_per_set;
-        bool debug;
-    };
-
-    enum {
-        DATA_READ,
-        DATA_WRITE,
-        INSTRUCTION_READ
+        std::string replacement; /* lru | plru | srrip | random | fifo | lfu, empty for lru */
+        int inclusion; /* nine, inclusive or exclusive, relative to the levels above */
+        bool sparse; /* tags kept only for the sets touched, for very large caches, see Cache::slot */
     };
 
     class BaseCacheDriver {
     public:
-        virtual int exec(int instruction, std::string address) = 0;
+        virtual int exec(int instruction, uint64_t address) = 0;
         virtual void summary(std::ostream &out) = 0;
         virtual ~BaseCacheDriver() = default;
     };
@@ -52,62 +64,164 @@ namespace cs {
      * A multi-level cache driver
      * takes an array of config structs, each entry corresponds to a level in cache
      * with configuration[0] being level 1, configuration[1] level 2 and so on
+     * any number of levels is supported
      */
     class CacheDriver : BaseCacheDriver {
         /*
-         * driver for caches on each level
-         * takes a config struct to initialize instruction and data internal caches
+         * one level of the hierarchy,
+         * split into instruction and data caches when the config has an instruction type, unified otherwise
          */
-        class Driver : public BaseCacheDriver {
-        public:
-            virtual double hit_plus_missrate() = 0;
-            virtual double get_miss_penalty() = 0;
-        };
-
-        class L1 : public Driver {
-        friend class CacheDriver;
-            cs::Cache *i_cache;
-            cs::Cache *d_cache;
-            int _hit_time, _miss_penalty;
-            bool _debug;
-        public:
-            explicit L1(config& configuration);
-            ~L1() override ;
-
-            int exec(int instruction, std::string address) override ;
-            double hit_plus_missrate () override;
-            double get_miss_penalty() override { return _miss_penalty; }
-            void summary(std::ostream &out) override ;
-            static void init (int conf, config& configuration, Cache **cache);
-        };
-
-        class L2 : public Driver {
+        class Level {
         friend class CacheDriver;
-            cs::Cache *cache;
+            cs::Cache *i_cache; /* nullptr for a unified level */
+            cs::Cache *d_cache; /* data cache, or the unified cache */
             int _hit_time, _miss_penalty;
-            bool _debug;
+            int _inclusion;
+            /* instruction and data halves of a batch, and their misses */
+            std::vector<uint32_t> _i_idx, _d_idx, _i_misses, _d_misses;
+            std::vector<Writeback> _writebacks; /* both halves' writebacks, merged */
         public:
-            explicit L2(config& configuration);
-            ~L2() override ;
-
-            double hit_plus_missrate () override;
-            double get_miss_penalty() override { return _miss_penalty; }
-            int exec(int instruction, std::string address) override ;
-            void summary(std::ostream &out) override ;
+            explicit Level(config& configuration);
+            ~Level();
+
+            Level(const Level&) = delete;
+            Level& operator=(const Level&) = delete;
+
+            Cache *cache_for(int instruction) const {
+                return instruction == INSTRUCTION_READ && i_cache != nullptr ? i_cache : d_cache;
+            }
+
+            /*
+             * runs refs[idx[0 .. count)] through this level, see Cache::exec_batch
+             */
+            size_t exec_batch(const Reference *refs, const uint32_t *idx, size_t count, uint32_t *misses);
+
+            /*
+             * writebacks logged by the last exec_batch, in reference order, for the caller to clear
+             */
+            std::vector<Writeback>& writebacks();
+            double miss_rate();
+            void summary(std::ostream &out);
         };
 
-
-        std::vector<Driver *>_levels;
+        std::vector<Level *>_levels;
+        bool _nine; /* no level is inclusive or exclusive, so levels never affect each other */
+        bool _observed; /* some observer is attached */
+        size_t _address_size; /* narrowest address size of any level */
+        std::vector<uint32_t> _idx, _misses; /* batch scratch, references still going down the hierarchy */
+        std::vector<Reference> _staged[2]; /* what a level passes on when it isn't just its misses */
     public:
 
         explicit CacheDriver (std::vector<config>&);
         ~CacheDriver () override ;
-        int exec(int instruction, std::string address) override ;
+
+        /*
+         * a single reference, HIT if any level had it
+         */
+        int exec(int instruction, uint64_t address) override ;
+
+        /*
+         * runs refs[0, count) through the hierarchy
+         * when every level is non-inclusive non-exclusive they run level by level,
+         * each level taking the misses of the one above it in one tight loop,
+         * along with the dirty blocks it wrote back,
+         * otherwise each reference walks the hierarchy with inclusion enforced on every eviction
+         * returns how many references missed every level
+         * throws before simulating anything if a reference has an unknown type or too wide an address
+         */
+        size_t exec(const Reference *refs, size_t count);
+
+        /*
+         * average memory access time of the whole hierarchy
+         */
         double AMAT ();
         void summary(std::ostream &out) override ;
+
+        /*
+         * every cache of the hierarchy, level by level,
+         * split levels as instruction then data cache
+         */
+        std::vector<Cache *> caches();
+
+        /* number of levels, and the caches of one, 0 for level 1, in the order of caches() */
+        size_t levels() const { return _levels.size(); }
+        std::vector<Cache *> caches(size_t level);
+
+        /* inclusion policy of a level, 0 for level 1 */
+        int inclusion(size_t level) const { return _levels[level]->_inclusion; }
+
+        /*
+         * traces every cache into sink, nullptr stops, a no-op unless TRACING is built in
+         * caches are named after their level -- L1i, L1d, L2 ...
+         */
+        void trace(TraceSink *sink);
+
+        /*
+         * three-C classification of every cache's misses, on by default,
+         * exec_partitioned turns it off for the last level
+         */
+        void classify(bool on);
+
+        /*
+         * attaches observer to every cache, events are handed over by the end of every exec()
+         * observed hierarchies can't run exec_partitioned
+         */
+        void observe(CacheObserver *observer);
+
+        /*
+         * runs refs[0, count) only to warm the caches' contents, see Cache::warm,
+         * nothing is counted, classified or observed
+         */
+        void warm(const Reference *refs, size_t count);
+
+        /*
+         * runs refs[0, count) with the sets of the last level split across `threads' workers
+         * (threads <= 0 uses every hardware thread), the levels above it run sequentially
+         * and each worker only sees the references that reach its sets,
+         * worker counters are merged into the caches, so summary() covers the run as usual,
+         * but for the three C's of the last level, which stops classifying its misses
+         * throws CSException unless every level is non-inclusive non-exclusive, or if it's observed
+         */
+        void exec_partitioned(const Reference *refs, size_t count, int threads);
     private:
-        double l1_amat();
-        double l2_amat();
+        static Cache *create(int type, config& configuration);
+
+        /* throws if a reference has an unknown type or too wide an address */
+        void check(const Reference *refs, size_t count) const;
+
+        /*
+         * runs refs[0, count) through levels [0, depth) level by level, see exec(),
+         * returns how many of them missed every one of those levels,
+         * the references going on below them are appended to `below' when it's given
+         */
+        size_t run(const Reference *refs, size_t count, size_t depth, std::vector<Reference> *below);
+
+        /*
+         * walks one reference down the hierarchy, returns HIT if some level had it
+         */
+        int access(const Reference& ref);
+
+        /*
+         * handles the eviction, if any, of the last access to `cache' of level `level'
+         */
+        void settle(size_t level, Cache *cache);
+
+        /*
+         * level `level' evicted the block at `victim':
+         * an inclusive level invalidates it above, an exclusive level below takes it,
+         * otherwise a dirty block is written back below
+         */
+        void evicted(size_t level, int instruction, uint64_t victim, bool dirty);
+
+        /*
+         * writes the dirty block at `block' back to level `level', and on down through write-through levels
+         */
+        void writeback(size_t level, uint64_t block);
+
+        /*
+         * average access time seen from `level' down
+         */
+        double amat(size_t level);
     };
 
 }
@@ -5,6 +5,7 @@
 #ifndef CACHE_SIM_ERRORS_HPP
 #define CACHE_SIM_ERRORS_HPP
 #include <exception>
+#include <string>
 
 struct CSException : public std::exception
 {
@@ -25,4 +26,31 @@ struct AddressExists : public CSException {
     AddressExists () : CSException("AddressExists") {}
 };
 
+/*
+ * malformed line in an input trace, carries the line number and its text
+ */
+struct InvalidLine : public CSException {
+protected:
+    std::string message;
+public:
+    InvalidLine (size_t line, const std::string& text)
+        : CSException("InvalidLine"), message("invalid line " + std::to_string(line) + " -- " + text) {}
+    const char * what() const throw() {
+        return message.c_str();
+    }
+};
+
+/*
+ * invalid simulator configuration, carries a description of what's wrong
+ */
+struct InvalidConfig : public CSException {
+protected:
+    std::string message;
+public:
+    explicit InvalidConfig (const std::string& message) : CSException("InvalidConfig"), message(message) {}
+    const char * what() const throw() {
+        return message.c_str();
+    }
+};
+
 #endif //CACHE_SIM_ERRORS_HPP
@@ -0,0 +1,283 @@
+/*
+ * Synthetic workload generators definition
+ */
+
+#include "generator.hpp"
+#include <cmath>
+#include <map>
+#include <set>
+#include "errors.hpp"
+
+namespace cs {
+
+    namespace {
+
+        const uint64_t CODE_BASE = 0x400000; /* where mixed workloads keep their code */
+        const uint64_t SCATTER = 2654435761u; /* prime, spreads Zipf ranks over the words */
+
+        /*
+         * parameters of every kind, see generator.hpp
+         */
+        struct Params {
+            uint64_t count, seed, base, size, step, stride, align, node, code;
+            double writes, alpha, ifetch;
+        };
+
+        /*
+         * sequential or strided walk, wrapping around size
+         */
+        class Walk : public Generator {
+            Params _p;
+            uint64_t _step, _offset;
+        public:
+            Walk(const Params& p, uint64_t step) : Generator(p.count), _p(p), _step(step), _offset(0) {
+                _rng.seed(p.seed);
+            }
+
+            void generate(Reference *refs, size_t count) override {
+                for (size_t i = 0; i < count; i++) {
+                    int type = _p.writes > 0 && uniform() < _p.writes ? DATA_WRITE : DATA_READ;
+                    refs[i] = Reference{_p.base + _offset, type, 0};
+                    _offset += _step;
+                    if (_offset >= _p.size)
+                        _offset -= _p.size;
+                }
+            }
+        };
+
+        class Uniform : public Generator {
+            Params _p;
+            uint64_t _words;
+        public:
+            explicit Uniform(const Params& p) : Generator(p.count), _p(p), _words(p.size / p.align) {
+                _rng.seed(p.seed);
+            }
+
+            void generate(Reference *refs, size_t count) override {
+                for (size_t i = 0; i < count; i++) {
+                    int type = _p.writes > 0 && uniform() < _p.writes ? DATA_WRITE : DATA_READ;
+                    refs[i] = Reference{_p.base + (_rng() % _words) * _p.align, type, 0};
+                }
+            }
+        };
+
+        /*
+         * Zipfian words, ranks scattered over the words so the hot ones don't share sets,
+         * and with a fraction of instruction fetches looping over code for mixed workloads
+         */
+        class Zipf : public Generator {
+            Params _p;
+            uint64_t _words, _pc;
+            double _ifetch;
+            ZipfSampler _zipf;
+        public:
+            Zipf(const Params& p, double ifetch)
+                    : Generator(p.count), _p(p), _words(p.size / p.align), _pc(0), _ifetch(ifetch),
+                      _zipf(p.size / p.align, p.alpha) {
+                _rng.seed(p.seed);
+            }
+
+            void generate(Reference *refs, size_t count) override {
+                for (size_t i = 0; i < count; i++) {
+                    if (_ifetch > 0 && uniform() < _ifetch) {
+                        refs[i] = Reference{CODE_BASE + _pc, INSTRUCTION_READ, 0};
+                        _pc += 4;
+                        if (_pc >= _p.code)
+                            _pc = 0;
+                        continue;
+                    }
+                    uint64_t rank = _zipf.sample([this]() { return uniform(); });
+                    uint64_t word = (rank - 1) * SCATTER % _words;
+                    int type = _p.writes > 0 && uniform() < _p.writes ? DATA_WRITE : DATA_READ;
+                    refs[i] = Reference{_p.base + word * _p.align, type, 0};
+                }
+            }
+        };
+
+        /*
+         * follows one random cycle through every node (Sattolo's shuffle),
+         * each address depends on the last like a linked list traversal
+         */
+        class Chase : public Generator {
+            Params _p;
+            std::vector<uint32_t> _next;
+            uint32_t _node;
+        public:
+            explicit Chase(const Params& p) : Generator(p.count), _p(p), _next(p.size / p.node), _node(0) {
+                _rng.seed(p.seed);
+                for (size_t i = 0; i < _next.size(); i++)
+                    _next[i] = static_cast<uint32_t>(i);
+                for (size_t i = _next.size() - 1; i > 0; i--)
+                    std::swap(_next[i], _next[_rng() % i]);
+            }
+
+            void generate(Reference *refs, size_t count) override {
+                for (size_t i = 0; i < count; i++) {
+                    int type = _p.writes > 0 && uniform() < _p.writes ? DATA_WRITE : DATA_READ;
+                    refs[i] = Reference{_p.base + static_cast<uint64_t>(_node) * _p.node, type, 0};
+                    _node = _next[_node];
+                }
+            }
+        };
+
+        std::vector<std::string> split(const std::string& s, char sep) {
+            std::vector<std::string> parts;
+            size_t begin = 0, end;
+            while ((end = s.find(sep, begin)) != std::string::npos) {
+                parts.push_back(s.substr(begin, end - begin));
+                begin = end + 1;
+            }
+            parts.push_back(s.substr(begin));
+            return parts;
+        }
+
+        /*
+         * a positive count or size, with a K, M or G suffix, decimal or 0x hex
+         */
+        uint64_t number(const std::string& value, const std::string& spec) {
+            size_t used = 0;
+            unsigned long long n = 0;
+            try {
+                if (!value.empty() && value[0] != '-')
+                    n = std::stoull(value, &used, 0);
+            } catch (std::exception&) {
+                used = 0;
+            }
+            if (used != 0 && used + 1 == value.size()) {
+                switch (value[used]) {
+                    case 'k': case 'K': n <<= 10; used++; break;
+                    case 'm': case 'M': n <<= 20; used++; break;
+                    case 'g': case 'G': n <<= 30; used++; break;
+                    default: break;
+                }
+            }
+            if (used == 0 || used != value.size() || n == 0)
+                throw InvalidConfig("invalid generator -- " + spec + ", bad number " + value);
+            return n;
+        }
+
+        double fraction(const std::string& value, const std::string& spec, bool unit) {
+            size_t used = 0;
+            double x = -1;
+            try {
+                x = std::stod(value, &used);
+            } catch (std::exception&) {
+                used = 0;
+            }
+            if (used == 0 || used != value.size() || x < 0 || (unit && x > 1) || (!unit && x == 0))
+                throw InvalidConfig("invalid generator -- " + spec + ", bad value " + value);
+            return x;
+        }
+    }
+
+    Generator::Generator(uint64_t count) : _left(count), _batch(BATCH) {}
+
+    size_t Generator::next_batch(const Reference *&batch) {
+        size_t n = _left < BATCH ? static_cast<size_t>(_left) : BATCH;
+        if (n == 0)
+            return 0;
+        generate(_batch.data(), n);
+        _left -= n;
+        batch = _batch.data();
+        return n;
+    }
+
+    Generator *Generator::create(const std::string& spec) {
+        static const std::map<std::string, std::set<std::string>> KEYS = {
+                {"seq", {"step"}},
+                {"stride", {"stride"}},
+                {"uniform", {"align"}},
+                {"zipf", {"align", "alpha"}},
+                {"chase", {"node"}},
+                {"mixed", {"align", "alpha", "code", "ifetch"}},
+        };
+
+        std::vector<std::string> fields = split(spec, ':');
+        const std::string& kind = fields[0];
+        auto keys = KEYS.find(kind);
+        if (keys == KEYS.end())
+            throw InvalidConfig("invalid generator -- " + spec
+                                + ", kinds are seq | stride | uniform | zipf | chase | mixed");
+
+        Params p = {1 << 20, 1, 0x10000000, 16 << 20, 4, 64, 8, 64, 16 << 10, 0, 0.99, 0.6};
+        for (size_t f = 1; f < fields.size(); f++) {
+            size_t eq = fields[f].find('=');
+            std::string key = fields[f].substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : fields[f].substr(eq + 1);
+            bool common = key == "n" || key == "seed" || key == "base" || key == "size" || key == "writes";
+            if (eq == std::string::npos || (!common && keys->second.count(key) == 0))
+                throw InvalidConfig("invalid generator -- " + spec + ", unknown key " + key + " for " + kind);
+            if (key == "n")
+                p.count = number(value, spec);
+            else if (key == "seed")
+                p.seed = value == "0" ? 0 : number(value, spec);
+            else if (key == "base")
+                p.base = value == "0" ? 0 : number(value, spec);
+            else if (key == "size")
+                p.size = number(value, spec);
+            else if (key == "writes")
+                p.writes = fraction(value, spec, true);
+            else if (key == "step")
+                p.step = number(value, spec);
+            else if (key == "stride")
+                p.stride = number(value, spec);
+            else if (key == "align")
+                p.align = number(value, spec);
+            else if (key == "node")
+                p.node = number(value, spec);
+            else if (key == "code")
+                p.code = number(value, spec);
+            else if (key == "alpha")
+                p.alpha = fraction(value, spec, false);
+            else if (key == "ifetch")
+                p.ifetch = fraction(value, spec, true);
+        }
+
+        if (kind == "seq")
+            return new Walk(p, p.step % p.size);
+        if (kind == "stride")
+            return new Walk(p, p.stride % p.size);
+        if (kind == "uniform" || kind == "zipf" || kind == "mixed") {
+            if (p.size < p.align)
+                throw InvalidConfig("invalid generator -- " + spec + ", size is below align");
+            if (kind == "uniform")
+                return new Uniform(p);
+            return new Zipf(p, kind == "mixed" ? p.ifetch : 0);
+        }
+        if (p.size / p.node < 2 || p.size / p.node > UINT32_MAX)
+            throw InvalidConfig("invalid generator -- " + spec + ", chase needs 2 to 2^32 nodes of size");
+        return new Chase(p);
+    }
+
+    /* h(x) = x^-alpha, h_integral its antiderivative, written to stay accurate near alpha = 1 */
+
+    static double helper1(double x) {
+        return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+    }
+
+    ZipfSampler::ZipfSampler(uint64_t n, double alpha) : _n(n), _alpha(alpha) {
+        _h_x1 = h_integral(1.5) - 1;
+        _h_n = h_integral(static_cast<double>(n) + 0.5);
+        _s = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+    }
+
+    double ZipfSampler::h(double x) const {
+        return std::exp(-_alpha * std::log(x));
+    }
+
+    double ZipfSampler::h_integral(double x) const {
+        double log_x = std::log(x);
+        return helper2((1 - _alpha) * log_x) * log_x;
+    }
+
+    double ZipfSampler::h_integral_inverse(double x) const {
+        double t = x * (1 - _alpha);
+        if (t < -1)
+            t = -1;
+        return std::exp(helper1(t) * x);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Synthetic workload generators,
+ * trace sources that make up their references in process from a seed and parameters
+ */
+
+#ifndef CACHE_SIM_GENERATOR_HPP
+#define CACHE_SIM_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "reference.hpp"
+#include "trace_source.hpp"
+
+namespace cs {
+
+/*
+ * a generator is named by a spec, `kind[:key=value ...]', e.g. `zipf:n=1G:alpha=1.1:seed=7'
+ *
+ *   seq      sequential walk, `step' bytes apart (default 4)
+ *   stride   strided walk, `stride' bytes apart (default 64)
+ *   uniform  uniformly random `align'-byte words (default 8)
+ *   zipf     Zipfian hot set of `align'-byte words, exponent `alpha' (default 0.99)
+ *   chase    pointer chase around one random cycle of `node'-byte nodes (default 64)
+ *   mixed    instruction fetches looping over `code' bytes (default 16K), a fraction `ifetch'
+ *            (default 0.6) of the references, the rest Zipfian data
+ *
+ * every kind takes
+ *   n        references (default 1M)
+ *   seed     random seed (default 1), the same spec always yields the same references
+ *   base     first address (default 0x10000000)
+ *   size     bytes the data addresses stay within, from base (default 16M)
+ *   writes   fraction of data references that are writes (default 0)
+ * counts and sizes take a K, M or G suffix
+ */
+    class Generator : public TraceSource {
+    public:
+        static const size_t BATCH = 16384; /* references per batch */
+
+        explicit Generator(uint64_t count);
+
+        size_t next_batch(const Reference *&batch) override;
+
+    /*
+     * generator for spec, throws InvalidConfig on unknown kinds, keys or values
+     */
+        static Generator *create(const std::string& spec);
+
+    protected:
+        std::mt19937_64 _rng;
+
+        /* uniform in [0, 1) */
+        double uniform() { return static_cast<double>(_rng() >> 11) * (1.0 / 9007199254740992.0); }
+
+        /* fills refs[0, count) with the next references */
+        virtual void generate(Reference *refs, size_t count) = 0;
+
+    private:
+        uint64_t _left; /* references still to make */
+        std::vector<Reference> _batch;
+    };
+
+/*
+ * Zipfian ranks 1 .. n, P(k) proportional to k^-alpha,
+ * by rejection-inversion (Hoermann and Derflinger), constant time and space for any n
+ */
+    class ZipfSampler {
+        uint64_t _n;
+        double _alpha;
+        double _h_x1, _h_n, _s;
+
+        double h(double x) const;
+        double h_integral(double x) const;
+        double h_integral_inverse(double x) const;
+
+    public:
+        /* alpha > 0 */
+        ZipfSampler(uint64_t n, double alpha);
+
+        /* a rank, drawing uniforms in [0, 1) from next() until one is accepted */
+        template <typename Next>
+        uint64_t sample(Next next) const;
+    };
+
+    template <typename Next>
+    uint64_t ZipfSampler::sample(Next next) const {
+        while (true) {
+            double u = _h_n + next() * (_h_x1 - _h_n);
+            double x = h_integral_inverse(u);
+            double k = x + 0.5;
+            if (k < 1)
+                k = 1;
+            else if (k > static_cast<double>(_n))
+                k = static_cast<double>(_n);
+            k = static_cast<double>(static_cast<uint64_t>(k));
+            if (k - x <= _s || u >= h_integral(k + 0.5) - h(k))
+                return static_cast<uint64_t>(k);
+        }
+    }
+
+}
+
+#endif //CACHE_SIM_GENERATOR_HPP
@@ -0,0 +1,537 @@
+/*
+ * Input stream definition
+ */
+
+#include "input_stream.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef CACHE_SIM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CACHE_SIM_HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef CACHE_SIM_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace cs {
+
+    static const size_t INPUT_CHUNK = 1 << 20; /* compressed bytes read at a time */
+
+    int compression_of(const unsigned char *magic, size_t len) {
+        if (len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+            return gzip_compressed;
+        if (len >= 6 && memcmp(magic, "\xfd" "7zXZ\0", 6) == 0)
+            return xz_compressed;
+        /* a zstd frame, or a skippable frame 0x184d2a5? that zstd streams may start with */
+        if (len >= 4 && ((magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+                         || ((magic[0] & 0xf0) == 0x50 && magic[1] == 0x2a && magic[2] == 0x4d && magic[3] == 0x18)))
+            return zstd_compressed;
+        return uncompressed;
+    }
+
+/*
+ * the raw bytes of fd, after `prefix' that was already read from it
+ */
+    class FdStream : public InputStream {
+        int _fd;
+        std::vector<char> _prefix;
+        size_t _used;
+
+    public:
+        FdStream(int fd, const char *prefix, size_t len) : _fd(fd), _prefix(prefix, prefix + len), _used(0) {}
+
+        size_t read(char *buf, size_t len) override {
+            if (_used < _prefix.size()) {
+                size_t n = std::min(len, _prefix.size() - _used);
+                memcpy(buf, _prefix.data() + _used, n);
+                _used += n;
+                return n;
+            }
+            ssize_t n;
+            do {
+                n = ::read(_fd, buf, len);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0)
+                throw CSException("error reading input file");
+            return static_cast<size_t>(n);
+        }
+    };
+
+/*
+ * independent blocks of a mapped file decompressed on helper threads,
+ * a window of blocks ahead of the reader is in flight and they're handed out in order
+ */
+    class FrameStream : public InputStream {
+    public:
+        typedef size_t (*size_fn)(const unsigned char *data, size_t len); /* 0 if data isn't a block */
+        typedef void (*decode_fn)(const unsigned char *data, size_t len, std::vector<char>& out);
+
+    private:
+        struct Slot {
+            const unsigned char *data;
+            size_t len;
+            std::vector<char> out;
+            bool ready;
+            std::exception_ptr error;
+        };
+
+        void *_map;
+        size_t _map_len, _pos; /* blocks before _pos are queued */
+        size_fn _size_of;
+        decode_fn _decode;
+
+        /* blocks [_head, _tail) are queued, [_head, _claimed) taken by a worker, slot i % size */
+        std::vector<Slot> _slots;
+        size_t _head, _tail, _claimed, _offset; /* _offset bytes of the head block were read */
+        std::mutex _mutex;
+        std::condition_variable _work, _ready;
+        bool _stop;
+        std::vector<std::thread> _workers;
+
+        /* queues blocks until the window is full, with _mutex held */
+        void queue() {
+            while (_tail - _head < _slots.size() && _pos < _map_len) {
+                const unsigned char *data = static_cast<const unsigned char *>(_map) + _pos;
+                size_t len = _size_of(data, _map_len - _pos);
+                if (len == 0)
+                    throw CSException("corrupt compressed input");
+                if (len > _map_len - _pos)
+                    throw CSException("truncated compressed input");
+                Slot& slot = _slots[_tail % _slots.size()];
+                slot.data = data;
+                slot.len = len;
+                slot.out.clear();
+                slot.ready = false;
+                slot.error = nullptr;
+                _tail++;
+                _pos += len;
+            }
+            _work.notify_all();
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (;;) {
+                _work.wait(lock, [this] { return _stop || _claimed < _tail; });
+                if (_stop)
+                    return;
+                Slot& slot = _slots[_claimed++ % _slots.size()];
+                lock.unlock();
+                try {
+                    _decode(slot.data, slot.len, slot.out);
+                } catch (...) {
+                    slot.error = std::current_exception();
+                }
+                lock.lock();
+                slot.ready = true;
+                _ready.notify_all();
+            }
+        }
+
+    public:
+    /*
+     * takes ownership of the mapping
+     */
+        FrameStream(void *map, size_t len, size_fn size_of, decode_fn decode)
+                : _map(map), _map_len(len), _pos(0), _size_of(size_of), _decode(decode),
+                  _head(0), _tail(0), _claimed(0), _offset(0), _stop(false) {
+            int threads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+            if (threads < 1)
+                threads = 1;
+            _slots.resize(4 * static_cast<size_t>(threads));
+            madvise(_map, _map_len, MADV_SEQUENTIAL);
+            for (int t = 0; t < threads; t++)
+                _workers.emplace_back(&FrameStream::work, this);
+        }
+
+        ~FrameStream() override {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _work.notify_all();
+            for (auto& worker : _workers)
+                worker.join();
+            munmap(_map, _map_len);
+        }
+
+        size_t read(char *buf, size_t len) override {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (;;) {
+                queue();
+                if (_head == _tail)
+                    return 0;
+                Slot& slot = _slots[_head % _slots.size()];
+                _ready.wait(lock, [&slot] { return slot.ready; });
+                if (slot.error)
+                    std::rethrow_exception(slot.error);
+
+                /* the head block is the reader's alone once it's ready */
+                size_t n = std::min(len, slot.out.size() - _offset);
+                lock.unlock();
+                memcpy(buf, slot.out.data() + _offset, n);
+                lock.lock();
+                _offset += n;
+                if (_offset == slot.out.size()) {
+                    _head++;
+                    _offset = 0;
+                }
+                if (n != 0 || len == 0)
+                    return n; /* an empty block, e.g. a skippable frame, moves on to the next */
+            }
+        }
+    };
+
+#ifdef CACHE_SIM_HAVE_ZLIB
+/*
+ * gzip, any number of members back to back
+ */
+    class GzipStream : public InputStream {
+        InputStream *_in;
+        std::vector<unsigned char> _buf;
+        z_stream _z;
+        bool _eof, _member_end;
+
+    public:
+        explicit GzipStream(InputStream *in) : _in(in), _buf(INPUT_CHUNK), _eof(false), _member_end(false) {
+            memset(&_z, 0, sizeof(_z));
+            if (inflateInit2(&_z, 15 + 16) != Z_OK) {
+                delete _in;
+                throw CSException("cannot initialize gzip decompression");
+            }
+        }
+
+        ~GzipStream() override {
+            inflateEnd(&_z);
+            delete _in;
+        }
+
+        size_t read(char *buf, size_t len) override {
+            _z.next_out = reinterpret_cast<Bytef *>(buf);
+            _z.avail_out = static_cast<uInt>(len);
+            while (_z.avail_out != 0) {
+                if (_z.avail_in == 0 && !_eof) {
+                    size_t n = _in->read(reinterpret_cast<char *>(_buf.data()), _buf.size());
+                    _eof = n == 0;
+                    _z.next_in = _buf.data();
+                    _z.avail_in = static_cast<uInt>(n);
+                }
+                if (_z.avail_in == 0 && _eof) {
+                    if (!_member_end)
+                        throw CSException("truncated gzip input");
+                    break;
+                }
+                if (_member_end) {
+                    inflateReset(&_z);
+                    _member_end = false;
+                }
+                int ret = inflate(&_z, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END)
+                    _member_end = true;
+                else if (ret != Z_OK && ret != Z_BUF_ERROR)
+                    throw CSException("corrupt gzip input");
+            }
+            return len - _z.avail_out;
+        }
+    };
+
+    /*
+     * size of the block gzip (bgzip) member at data, from its BC extra field
+     */
+    static size_t bgzf_member_size(const unsigned char *data, size_t len) {
+        if (len < 18 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || (data[3] & 4) == 0)
+            return 0;
+        size_t xlen = data[10] | (data[11] << 8);
+        if (12 + xlen > len)
+            return 0;
+        /* sizes past the end of the file are returned as is, they mean a truncated file */
+        for (size_t i = 12; i + 4 <= 12 + xlen; ) {
+            size_t slen = data[i + 2] | (data[i + 3] << 8);
+            if (data[i] == 'B' && data[i + 1] == 'C' && slen == 2 && i + 6 <= 12 + xlen)
+                return (data[i + 4] | (data[i + 5] << 8)) + size_t(1);
+            i += 4 + slen;
+        }
+        return 0;
+    }
+
+    static void inflate_member(const unsigned char *data, size_t len, std::vector<char>& out) {
+        /* the trailer ends in the member's uncompressed size */
+        const unsigned char *isize = data + len - 4;
+        out.resize(isize[0] | (isize[1] << 8) | (isize[2] << 16) | (uint32_t(isize[3]) << 24));
+
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        if (inflateInit2(&z, 15 + 16) != Z_OK)
+            throw CSException("cannot initialize gzip decompression");
+        z.next_in = const_cast<Bytef *>(data);
+        z.avail_in = static_cast<uInt>(len);
+        z.next_out = reinterpret_cast<Bytef *>(out.data());
+        z.avail_out = static_cast<uInt>(out.size());
+        int ret = inflate(&z, Z_FINISH);
+        bool complete = ret == Z_STREAM_END && z.avail_out == 0;
+        inflateEnd(&z);
+        if (!complete)
+            throw CSException("corrupt gzip input");
+    }
+#endif
+
+#ifdef CACHE_SIM_HAVE_LZMA
+/*
+ * xz, any number of streams back to back,
+ * blocks of multi-block files are decoded on liblzma's threads
+ */
+    class XzStream : public InputStream {
+        InputStream *_in;
+        std::vector<uint8_t> _buf;
+        lzma_stream _s;
+        bool _eof, _end;
+
+    public:
+        explicit XzStream(InputStream *in) : _in(in), _buf(INPUT_CHUNK), _eof(false), _end(false) {
+            memset(&_s, 0, sizeof(_s)); /* LZMA_STREAM_INIT */
+            lzma_ret ret;
+#if LZMA_VERSION >= 50040002
+            lzma_mt mt;
+            memset(&mt, 0, sizeof(mt));
+            mt.flags = LZMA_CONCATENATED;
+            mt.threads = std::max(1u, std::thread::hardware_concurrency());
+            mt.memlimit_threading = lzma_physmem() / 4;
+            mt.memlimit_stop = UINT64_MAX;
+            ret = lzma_stream_decoder_mt(&_s, &mt);
+#else
+            ret = lzma_stream_decoder(&_s, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+            if (ret != LZMA_OK) {
+                delete _in;
+                throw CSException("cannot initialize xz decompression");
+            }
+        }
+
+        ~XzStream() override {
+            lzma_end(&_s);
+            delete _in;
+        }
+
+        size_t read(char *buf, size_t len) override {
+            _s.next_out = reinterpret_cast<uint8_t *>(buf);
+            _s.avail_out = len;
+            while (_s.avail_out != 0 && !_end) {
+                if (_s.avail_in == 0 && !_eof) {
+                    size_t n = _in->read(reinterpret_cast<char *>(_buf.data()), _buf.size());
+                    _eof = n == 0;
+                    _s.next_in = _buf.data();
+                    _s.avail_in = n;
+                }
+                lzma_ret ret = lzma_code(&_s, _eof ? LZMA_FINISH : LZMA_RUN);
+                if (ret == LZMA_STREAM_END)
+                    _end = true;
+                else if (ret != LZMA_OK)
+                    throw CSException(ret == LZMA_BUF_ERROR ? "truncated xz input" : "corrupt xz input");
+            }
+            return len - _s.avail_out;
+        }
+    };
+#endif
+
+#ifdef CACHE_SIM_HAVE_ZSTD
+/*
+ * zstd, any number of frames back to back
+ */
+    class ZstdStream : public InputStream {
+        InputStream *_in;
+        std::vector<char> _buf;
+        ZSTD_inBuffer _input;
+        ZSTD_DStream *_d;
+        bool _eof;
+        size_t _pending; /* non-zero while a frame is incomplete */
+
+    public:
+        explicit ZstdStream(InputStream *in) : _in(in), _buf(INPUT_CHUNK), _input{nullptr, 0, 0},
+                                               _d(ZSTD_createDStream()), _eof(false), _pending(0) {
+            if (_d == nullptr || ZSTD_isError(ZSTD_initDStream(_d))) {
+                ZSTD_freeDStream(_d);
+                delete _in;
+                throw CSException("cannot initialize zstd decompression");
+            }
+        }
+
+        ~ZstdStream() override {
+            ZSTD_freeDStream(_d);
+            delete _in;
+        }
+
+        size_t read(char *buf, size_t len) override {
+            ZSTD_outBuffer output = {buf, len, 0};
+            while (output.pos < output.size) {
+                if (_input.pos == _input.size && !_eof) {
+                    size_t n = _in->read(_buf.data(), _buf.size());
+                    _eof = n == 0;
+                    _input = ZSTD_inBuffer{_buf.data(), n, 0};
+                }
+                if (_input.pos == _input.size && _eof) {
+                    if (_pending != 0)
+                        throw CSException("truncated zstd input");
+                    break;
+                }
+                _pending = ZSTD_decompressStream(_d, &output, &_input);
+                if (ZSTD_isError(_pending))
+                    throw CSException("corrupt zstd input");
+            }
+            return output.pos;
+        }
+    };
+
+    static size_t zstd_frame_size(const unsigned char *data, size_t len) {
+        size_t size = ZSTD_findFrameCompressedSize(data, len);
+        return ZSTD_isError(size) ? 0 : size;
+    }
+
+    static void decompress_frame(const unsigned char *data, size_t len, std::vector<char>& out) {
+        unsigned long long size = ZSTD_getFrameContentSize(data, len);
+        if (size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR) {
+            out.resize(size);
+            size_t n = ZSTD_decompress(out.data(), out.size(), data, len);
+            if (ZSTD_isError(n) || n != size)
+                throw CSException("corrupt zstd input");
+            return;
+        }
+
+        /* no content size in the header, grow the output as it comes */
+        ZSTD_DStream *d = ZSTD_createDStream();
+        if (d == nullptr || ZSTD_isError(ZSTD_initDStream(d))) {
+            ZSTD_freeDStream(d);
+            throw CSException("cannot initialize zstd decompression");
+        }
+        ZSTD_inBuffer input = {data, len, 0};
+        size_t pending = 1;
+        out.resize(ZSTD_DStreamOutSize());
+        size_t used = 0;
+        while (pending != 0 && (input.pos < input.size || used == out.size())) {
+            if (used == out.size())
+                out.resize(out.size() * 2);
+            ZSTD_outBuffer output = {out.data() + used, out.size() - used, 0};
+            pending = ZSTD_decompressStream(d, &output, &input);
+            used += output.pos;
+            if (ZSTD_isError(pending)) {
+                ZSTD_freeDStream(d);
+                throw CSException("corrupt zstd input");
+            }
+        }
+        ZSTD_freeDStream(d);
+        if (pending != 0)
+            throw CSException("truncated zstd input");
+        out.resize(used);
+    }
+#endif
+
+    /*
+     * fd's compressed contents decompressed in line, starting with prefix
+     */
+    static InputStream *decompress(int kind, int fd, const char *prefix, size_t len) {
+        InputStream *raw = new FdStream(fd, prefix, len);
+        switch (kind) {
+            case gzip_compressed:
+#ifdef CACHE_SIM_HAVE_ZLIB
+                return new GzipStream(raw);
+#else
+                delete raw;
+                throw CSException("gzip input needs cache-sim built with zlib");
+#endif
+            case xz_compressed:
+#ifdef CACHE_SIM_HAVE_LZMA
+                return new XzStream(raw);
+#else
+                delete raw;
+                throw CSException("xz input needs cache-sim built with liblzma");
+#endif
+            case zstd_compressed:
+#ifdef CACHE_SIM_HAVE_ZSTD
+                return new ZstdStream(raw);
+#else
+                delete raw;
+                throw CSException("zstd input needs cache-sim built with libzstd");
+#endif
+            default:
+                return raw;
+        }
+    }
+
+    /*
+     * a block decompressor over the regular file at fd when it has more than one block, nullptr otherwise
+     */
+    static InputStream *decompress_blocks(int kind, int fd, size_t size) {
+        FrameStream::size_fn size_of = nullptr;
+        FrameStream::decode_fn decode = nullptr;
+#ifdef CACHE_SIM_HAVE_ZLIB
+        if (kind == gzip_compressed) {
+            size_of = bgzf_member_size;
+            decode = inflate_member;
+        }
+#endif
+#ifdef CACHE_SIM_HAVE_ZSTD
+        if (kind == zstd_compressed) {
+            size_of = zstd_frame_size;
+            decode = decompress_frame;
+        }
+#endif
+        if (size_of == nullptr)
+            return nullptr;
+
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            return nullptr;
+        size_t first = size_of(static_cast<const unsigned char *>(map), size);
+        if (first == 0 || first >= size) {
+            munmap(map, size);
+            return nullptr;
+        }
+        return new FrameStream(map, size, size_of, decode);
+    }
+
+    InputStream *InputStream::open(int fd) {
+        unsigned char magic[8];
+        size_t len = 0;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            ssize_t n;
+            do {
+                n = pread(fd, magic, sizeof(magic), 0);
+            } while (n < 0 && errno == EINTR);
+            len = n > 0 ? static_cast<size_t>(n) : 0;
+            int kind = compression_of(magic, len);
+            if (kind != uncompressed) {
+                InputStream *blocks = decompress_blocks(kind, fd, static_cast<size_t>(st.st_size));
+                if (blocks != nullptr)
+                    return blocks;
+            }
+            return decompress(kind, fd, nullptr, 0);
+        }
+
+        /* a pipe -- the magic bytes are consumed, they go first in the stream */
+        while (len < sizeof(magic)) {
+            ssize_t n = ::read(fd, magic + len, sizeof(magic) - len);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                throw CSException("error reading input file");
+            if (n == 0)
+                break;
+            len += static_cast<size_t>(n);
+        }
+        return decompress(compression_of(magic, len), fd, reinterpret_cast<const char *>(magic), len);
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Input streams,
+ * the bytes of a trace, decompressed on the fly when it's gzip, xz or zstd compressed
+ */
+
+#ifndef CACHE_SIM_INPUT_STREAM_HPP
+#define CACHE_SIM_INPUT_STREAM_HPP
+
+#include <cstddef>
+
+#include "errors.hpp"
+
+namespace cs {
+
+    enum compression {
+        uncompressed,
+        gzip_compressed,
+        xz_compressed,
+        zstd_compressed
+    };
+
+    /*
+     * compression of a stream starting with magic[0, len)
+     */
+    int compression_of(const unsigned char *magic, size_t len);
+
+    class InputStream {
+    public:
+    /*
+     * reads up to len bytes into buf, returns 0 at the end of the stream
+     * throws CSException on read errors and corrupt or truncated compressed data
+     */
+        virtual size_t read(char *buf, size_t len) = 0;
+        virtual ~InputStream() = default;
+
+    /*
+     * stream over the file open at fd, which the caller keeps and closes,
+     * compression is detected from the first bytes
+     *
+     * regular files made of several independent blocks -- zstd frames or
+     * block gzip (bgzip) members -- are decompressed on helper threads,
+     * xz uses liblzma's threaded decoder, everything else decompresses in line
+     *
+     * throws CSException when the compression wasn't built in
+     */
+        static InputStream *open(int fd);
+    };
+
+}
+
+#endif //CACHE_SIM_INPUT_STREAM_HPP
@@ -0,0 +1,362 @@
+/*
+ * Interval statistics definition
+ */
+
+#include "intervals.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace cs {
+
+    static const char INTERVALS_MAGIC[8] = {'C', 'S', 'I', 'V', 'A', 'L', 'S', '\0'};
+
+    struct IntervalHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t caches;
+        uint64_t length;
+        uint32_t unit;
+        uint32_t reserved;
+    };
+
+    struct IntervalCacheRecord {
+        char name[16];
+        uint32_t level;
+        uint32_t hit_time;
+        uint32_t miss_penalty;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(IntervalHeader) == 32, "interval file header must be 32 bytes");
+    static_assert(sizeof(IntervalCacheRecord) == 32, "interval file cache records must be 32 bytes");
+
+    /*
+     * a positive count, with a K, M or G suffix
+     */
+    static uint64_t count_of(const std::string& value, const std::string& spec) {
+        size_t used = 0;
+        unsigned long long n = 0;
+        try {
+            if (!value.empty() && value[0] != '-')
+                n = std::stoull(value, &used, 10);
+        } catch (std::exception&) {
+            used = 0;
+        }
+        if (used != 0 && used + 1 == value.size()) {
+            switch (value[used]) {
+                case 'k': case 'K': n <<= 10; used++; break;
+                case 'm': case 'M': n <<= 20; used++; break;
+                case 'g': case 'G': n <<= 30; used++; break;
+                default: break;
+            }
+        }
+        if (used == 0 || used != value.size() || n == 0)
+            throw InvalidConfig("invalid interval -- " + spec + ", expected N references or Nc cycles");
+        return n;
+    }
+
+    /*
+     * waits for the other side of a ring, spinning briefly, then yielding, then sleeping,
+     * so an idle writer thread doesn't hold on to a core
+     */
+    static void backoff(unsigned& spins) {
+        if (++spins < 64)
+            return;
+        if (spins < 128)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    IntervalSpec IntervalSpec::parse(const std::string& spec) {
+        IntervalSpec interval;
+        bool cycles = !spec.empty() && (spec.back() == 'c' || spec.back() == 'C');
+        interval.length = count_of(cycles ? spec.substr(0, spec.size() - 1) : spec, spec);
+        interval.unit = cycles ? INTERVAL_CYCLES : INTERVAL_REFERENCES;
+        return interval;
+    }
+
+    double interval_amat(const std::vector<IntervalCache>& caches, const uint64_t *counters) {
+        int levels = caches.empty() ? 0 : caches.back().level + 1;
+        double below = 0;
+        for (int l = levels - 1; l >= 0; l--) {
+            double hits = 0, misses = 0;
+            int hit_time = 0, miss_penalty = 0;
+            for (size_t c = 0; c < caches.size(); c++) {
+                if (caches[c].level != l)
+                    continue;
+                hits += static_cast<double>(counters[3 * c]);
+                misses += static_cast<double>(counters[3 * c + 1]);
+                hit_time = caches[c].hit_time;
+                miss_penalty = caches[c].miss_penalty;
+            }
+            double miss_rate = hits + misses == 0 ? 0.0 : misses / (hits + misses);
+            below = hit_time + miss_rate * (l + 1 == levels ? miss_penalty : below);
+        }
+        return below;
+    }
+
+    void interval_csv_header(std::string& out, const std::vector<IntervalCache>& caches) {
+        out += "interval,first,references,cycles,amat";
+        for (auto& cache : caches) {
+            for (const char *column : {"_hits", "_misses", "_writebacks", "_amat"})
+                out += "," + cache.name + column;
+        }
+        out += "\n";
+    }
+
+    void interval_csv_row(std::string& out, const std::vector<IntervalCache>& caches, uint64_t index,
+                          uint64_t first, uint64_t references, const uint64_t *counters) {
+        char field[64];
+        double amat = interval_amat(caches, counters);
+        snprintf(field, sizeof(field), "%llu,%llu,%llu,%.0f,%g", (unsigned long long) index,
+                 (unsigned long long) first, (unsigned long long) references, amat * (double) references, amat);
+        out += field;
+        for (size_t c = 0; c < caches.size(); c++) {
+            uint64_t hits = counters[3 * c], misses = counters[3 * c + 1];
+            double miss_rate = hits + misses == 0 ? 0.0 : (double) misses / (double) (hits + misses);
+            snprintf(field, sizeof(field), ",%llu,%llu,%llu,%g", (unsigned long long) hits,
+                     (unsigned long long) misses, (unsigned long long) counters[3 * c + 2],
+                     caches[c].hit_time + miss_rate * caches[c].miss_penalty);
+            out += field;
+        }
+        out += "\n";
+    }
+
+    IntervalWriter::IntervalWriter(const char *path, const std::vector<IntervalCache>& caches, const IntervalSpec& spec)
+            : _caches(caches), _record(2 + 3 * caches.size()), _out(nullptr), _pool(DEPTH), _full(DEPTH + 1),
+              _free(DEPTH), _current(nullptr), _written(0), _closed(false) {
+        size_t length = strlen(path);
+        _csv = length >= 4 && strcmp(path + length - 4, ".csv") == 0;
+        _out = std::fopen(path, "wb");
+        if (_out == nullptr)
+            throw CSException("invalid interval file");
+        std::setvbuf(_out, nullptr, _IOFBF, 1 << 20);
+
+        bool written;
+        if (_csv) {
+            std::string header;
+            interval_csv_header(header, _caches);
+            written = std::fwrite(header.data(), header.size(), 1, _out) == 1;
+        } else {
+            IntervalHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, INTERVALS_MAGIC, sizeof(INTERVALS_MAGIC));
+            header.version = INTERVALS_VERSION;
+            header.caches = static_cast<uint32_t>(_caches.size());
+            header.length = spec.length;
+            header.unit = static_cast<uint32_t>(spec.unit);
+            written = std::fwrite(&header, sizeof(header), 1, _out) == 1;
+            for (auto& cache : _caches) {
+                IntervalCacheRecord r;
+                memset(&r, 0, sizeof(r));
+                strncpy(r.name, cache.name.c_str(), sizeof(r.name) - 1);
+                r.level = static_cast<uint32_t>(cache.level);
+                r.hit_time = static_cast<uint32_t>(cache.hit_time);
+                r.miss_penalty = static_cast<uint32_t>(cache.miss_penalty);
+                written = written && std::fwrite(&r, sizeof(r), 1, _out) == 1;
+            }
+        }
+        if (!written) {
+            std::fclose(_out);
+            throw CSException("error writing interval file");
+        }
+
+        /* whole records per chunk */
+        for (auto& chunk : _pool) {
+            chunk.words.resize(std::max(CHUNK / _record, size_t(1)) * _record);
+            chunk.size = 0;
+            (void) _free.push(&chunk);
+        }
+        _thread = std::thread(&IntervalWriter::write_chunks, this);
+    }
+
+    IntervalWriter::~IntervalWriter() {
+        try {
+            close();
+        } catch (...) {
+            /* nothing to report it to */
+        }
+    }
+
+    void IntervalWriter::write(uint64_t first, uint64_t references, const uint64_t *counters) {
+        if (_current == nullptr) {
+            for (unsigned spins = 0; !_free.pop(_current); backoff(spins))
+                ;
+        }
+        uint64_t *record = _current->words.data() + _current->size;
+        record[0] = first;
+        record[1] = references;
+        std::copy(counters, counters + _record - 2, record + 2);
+        _current->size += _record;
+        if (_current->size == _current->words.size()) {
+            for (unsigned spins = 0; !_full.push(_current); backoff(spins))
+                ;
+            _current = nullptr;
+        }
+    }
+
+    void IntervalWriter::write_chunks() {
+        std::string text;
+        while (true) {
+            Chunk *chunk;
+            for (unsigned spins = 0; !_full.pop(chunk); backoff(spins))
+                ;
+            if (chunk == nullptr)
+                return;
+
+            /* after an error the chunks are only recycled, close() reports it */
+            if (!_error) {
+                try {
+                    bool written;
+                    if (_csv) {
+                        text.clear();
+                        for (size_t at = 0; at < chunk->size; at += _record) {
+                            const uint64_t *record = chunk->words.data() + at;
+                            interval_csv_row(text, _caches, _written++, record[0], record[1], record + 2);
+                        }
+                        written = std::fwrite(text.data(), text.size(), 1, _out) == 1;
+                    } else {
+                        written = std::fwrite(chunk->words.data(), sizeof(uint64_t) * chunk->size, 1, _out) == 1;
+                    }
+                    if (!written)
+                        throw CSException("error writing interval file");
+                } catch (...) {
+                    _error = std::current_exception();
+                }
+            }
+            chunk->size = 0;
+            (void) _free.push(chunk);
+        }
+    }
+
+    void IntervalWriter::close() {
+        if (_closed)
+            return;
+        _closed = true;
+        if (_current != nullptr && _current->size != 0) {
+            for (unsigned spins = 0; !_full.push(_current); backoff(spins))
+                ;
+        }
+        _current = nullptr;
+        for (unsigned spins = 0; !_full.push(nullptr); backoff(spins))
+            ;
+        _thread.join();
+        bool closed = std::fclose(_out) == 0;
+        if (_error)
+            std::rethrow_exception(_error);
+        if (!closed)
+            throw CSException("error writing interval file");
+    }
+
+    IntervalRecorder::IntervalRecorder(CacheDriver& driver, const IntervalSpec& spec, const char *path, uint64_t position)
+            : _caches(driver.caches()), _layout(layout(driver)), _spec(spec), _writer(path, _layout, spec),
+              _start(3 * _caches.size(), 0), _delta(3 * _caches.size(), 0), _first(position), _references(0) {
+        measure();
+        _start.swap(_delta);
+    }
+
+    std::vector<IntervalCache> IntervalRecorder::layout(CacheDriver& driver) {
+        std::vector<IntervalCache> caches;
+        for (size_t l = 0; l < driver.levels(); l++) {
+            for (auto cache : driver.caches(l))
+                caches.push_back(IntervalCache{cache->name(), static_cast<int>(l), cache->hit_time(), cache->miss_penalty()});
+        }
+        return caches;
+    }
+
+    void IntervalRecorder::measure() {
+        for (size_t c = 0; c < _caches.size(); c++) {
+            const CacheStats& stats = _caches[c]->stats();
+            _delta[3 * c] = stats.hits - _start[3 * c];
+            _delta[3 * c + 1] = stats.misses - _start[3 * c + 1];
+            _delta[3 * c + 2] = stats.writebacks - _start[3 * c + 2];
+        }
+    }
+
+    uint64_t IntervalRecorder::room() const {
+        if (_spec.unit == INTERVAL_CYCLES)
+            return SLICE;
+        return _spec.length - _references;
+    }
+
+    void IntervalRecorder::advance(uint64_t count) {
+        _references += count;
+        if (_spec.unit == INTERVAL_REFERENCES) {
+            if (_references == _spec.length) {
+                measure();
+                cut();
+            }
+            return;
+        }
+
+        measure();
+        if (interval_amat(_layout, _delta.data()) * static_cast<double>(_references) >= static_cast<double>(_spec.length))
+            cut();
+    }
+
+    void IntervalRecorder::cut() {
+        _writer.write(_first, _references, _delta.data());
+        for (size_t i = 0; i < _start.size(); i++)
+            _start[i] += _delta[i];
+        _first += _references;
+        _references = 0;
+    }
+
+    void IntervalRecorder::finish() {
+        if (_references != 0) {
+            measure();
+            cut();
+        }
+        _writer.close();
+    }
+
+    IntervalReader::IntervalReader(const char *path) : _in(nullptr) {
+        _in = std::fopen(path, "rb");
+        if (_in == nullptr)
+            throw CSException("invalid interval file");
+        try {
+            IntervalHeader header;
+            if (std::fread(&header, sizeof(header), 1, _in) != 1)
+                throw CSException("invalid interval file -- too short");
+            if (memcmp(header.magic, INTERVALS_MAGIC, sizeof(INTERVALS_MAGIC)) != 0)
+                throw CSException("invalid interval file -- bad magic, CSV interval files are read as they are");
+            if (header.version != INTERVALS_VERSION)
+                throw CSException("invalid interval file -- unsupported version");
+            if (header.caches == 0 || header.unit > INTERVAL_CYCLES || header.length == 0)
+                throw CSException("invalid interval file -- bad header");
+            _spec = IntervalSpec{header.length, static_cast<int>(header.unit)};
+
+            for (uint32_t c = 0; c < header.caches; c++) {
+                IntervalCacheRecord r;
+                if (std::fread(&r, sizeof(r), 1, _in) != 1)
+                    throw CSException("invalid interval file -- truncated");
+                int level = static_cast<int>(r.level);
+                if (level < (_caches.empty() ? 0 : _caches.back().level) || level > (_caches.empty() ? 0 : _caches.back().level + 1))
+                    throw CSException("invalid interval file -- caches out of level order");
+                _caches.push_back(IntervalCache{std::string(r.name, strnlen(r.name, sizeof(r.name))), level,
+                                                static_cast<int>(r.hit_time), static_cast<int>(r.miss_penalty)});
+            }
+        } catch (...) {
+            std::fclose(_in);
+            throw;
+        }
+    }
+
+    IntervalReader::~IntervalReader() {
+        std::fclose(_in);
+    }
+
+    bool IntervalReader::next(uint64_t& first, uint64_t& references, uint64_t *counters) {
+        uint64_t head[2];
+        size_t read = std::fread(head, sizeof(uint64_t), 2, _in);
+        if (read == 0 && std::feof(_in))
+            return false;
+        if (read != 2 || std::fread(counters, sizeof(uint64_t), 3 * _caches.size(), _in) != 3 * _caches.size())
+            throw CSException("invalid interval file -- truncated record");
+        first = head[0];
+        references = head[1];
+        return true;
+    }
+}
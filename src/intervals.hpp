@@ -0,0 +1,209 @@
+/*
+ * Interval statistics,
+ * every cache's counters over consecutive intervals of a run, to follow its phases
+ *
+ * binary layout (host byte order):
+ *
+ *   header, 32 bytes
+ *     char     magic[8]      "CSIVALS" followed by '\0'
+ *     uint32   version       INTERVALS_VERSION
+ *     uint32   caches        number of caches, in CacheDriver::caches() order
+ *     uint64   length        references or cycles per interval
+ *     uint32   unit          INTERVAL_REFERENCES or INTERVAL_CYCLES
+ *     uint32   reserved      0
+ *
+ *   for every cache, 32 bytes
+ *     char     name[16]      Cache::name(), '\0' padded
+ *     uint32   level         0 for level 1
+ *     uint32   hit_time      cycles
+ *     uint32   miss_penalty  cycles
+ *     uint32   reserved      0
+ *
+ *   then a record per interval, to the end of the file
+ *     uint64   first         reference the interval starts at
+ *     uint64   references
+ *     uint64   hits, misses, writebacks of every cache in turn
+ *
+ * the CSV format is a header line and a row per interval,
+ *   interval,first,references,cycles,amat, then hits,misses,writebacks,amat of every cache
+ */
+
+#ifndef CACHE_SIM_INTERVALS_HPP
+#define CACHE_SIM_INTERVALS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "driver.hpp"
+#include "errors.hpp"
+#include "spsc_ring.hpp"
+
+namespace cs {
+
+    const uint32_t INTERVALS_VERSION = 1;
+
+    enum interval_unit {
+        INTERVAL_REFERENCES,
+        INTERVAL_CYCLES /* references until their simulated cycles, references * AMAT, reach the length */
+    };
+
+/*
+ * `N' references or `Nc' simulated cycles per interval, counts take a K, M or G suffix
+ */
+    struct IntervalSpec {
+        uint64_t length;
+        int unit;
+
+        /* throws InvalidConfig on a malformed spec */
+        static IntervalSpec parse(const std::string& spec);
+    };
+
+/*
+ * a cache as interval records see it
+ */
+    struct IntervalCache {
+        std::string name;
+        int level; /* 0 for level 1 */
+        int hit_time, miss_penalty;
+    };
+
+/*
+ * AMAT of the whole hierarchy from counters laid out as in a record, hits, misses and writebacks
+ * of every cache in turn, level by level as CacheDriver::AMAT
+ */
+    double interval_amat(const std::vector<IntervalCache>& caches, const uint64_t *counters);
+
+/*
+ * the CSV header line, and the row of interval `index', appended to out
+ */
+    void interval_csv_header(std::string& out, const std::vector<IntervalCache>& caches);
+    void interval_csv_row(std::string& out, const std::vector<IntervalCache>& caches, uint64_t index,
+                          uint64_t first, uint64_t references, const uint64_t *counters);
+
+/*
+ * writes records to a file on a thread of its own, so the simulation never waits on the file
+ *
+ * records are packed into fixed-size chunks handed over a lock-free ring and recycled through
+ * a second one, like PipelinedSource's batches, and formatted and written by the writer thread,
+ * which sleeps while there's nothing to write
+ * CSV when the file name ends in .csv, binary otherwise
+ */
+    class IntervalWriter {
+        static const size_t CHUNK = 8192; /* words of records per chunk */
+        static const size_t DEPTH = 8; /* chunks in flight */
+
+        struct Chunk {
+            std::vector<uint64_t> words;
+            size_t size;
+        };
+
+        std::vector<IntervalCache> _caches;
+        size_t _record; /* words per record */
+        bool _csv;
+        std::FILE *_out;
+        std::vector<Chunk> _pool;
+        SpscRing<Chunk *> _full, _free;
+        Chunk *_current; /* chunk being filled, nullptr until the first record */
+        uint64_t _written; /* records formatted so far, numbering CSV rows */
+        std::exception_ptr _error; /* set by the writer before it takes the last chunk */
+        std::thread _thread;
+        bool _closed;
+
+        void write_chunks();
+
+    public:
+    /*
+     * creates the file at path and writes its header, throws CSException if it can't
+     */
+        IntervalWriter(const char *path, const std::vector<IntervalCache>& caches, const IntervalSpec& spec);
+        ~IntervalWriter();
+
+        IntervalWriter(const IntervalWriter&) = delete;
+        IntervalWriter& operator=(const IntervalWriter&) = delete;
+
+    /*
+     * queues the record of an interval, counters as in the layout above
+     */
+        void write(uint64_t first, uint64_t references, const uint64_t *counters);
+
+    /*
+     * writes what's queued and closes the file, throws CSException if any of it couldn't be written
+     */
+        void close();
+    };
+
+/*
+ * cuts a run into intervals and hands their counters to an IntervalWriter
+ *
+ * the caller runs references in steps of at most room() and reports each with advance(),
+ * intervals of cycles are checked every SLICE references, so they close on the first
+ * check past their length and records carry the references and cycles they ended up with
+ * the caches' own counters are only read, so the summary still covers the whole run
+ */
+    class IntervalRecorder {
+        std::vector<Cache *> _caches;
+        std::vector<IntervalCache> _layout;
+        IntervalSpec _spec;
+        IntervalWriter _writer;
+        std::vector<uint64_t> _start, _delta; /* counters at the start of the interval, and since */
+        uint64_t _first, _references; /* the interval so far */
+
+        static std::vector<IntervalCache> layout(CacheDriver& driver);
+
+        /* the counters since the start of the interval into _delta */
+        void measure();
+
+        /* records the interval measured and starts the next */
+        void cut();
+
+    public:
+        static const size_t SLICE = 4096;
+
+    /*
+     * intervals of driver's caches written to path, starting at reference `position' of the trace
+     */
+        IntervalRecorder(CacheDriver& driver, const IntervalSpec& spec, const char *path, uint64_t position);
+
+        /* references the caller may run before the next advance() */
+        uint64_t room() const;
+
+        /* count references were run */
+        void advance(uint64_t count);
+
+        /* records the last, partial, interval and closes the file */
+        void finish();
+    };
+
+/*
+ * reads a binary interval file, throws CSException on a malformed one
+ */
+    class IntervalReader {
+        std::FILE *_in;
+        std::vector<IntervalCache> _caches;
+        IntervalSpec _spec;
+
+    public:
+        explicit IntervalReader(const char *path);
+        ~IntervalReader();
+
+        IntervalReader(const IntervalReader&) = delete;
+        IntervalReader& operator=(const IntervalReader&) = delete;
+
+        const std::vector<IntervalCache>& caches() const { return _caches; }
+        const IntervalSpec& spec() const { return _spec; }
+
+    /*
+     * the next record, false at the end of the file
+     * counters must have room for 3 * caches().size() words
+     */
+        bool next(uint64_t& first, uint64_t& references, uint64_t *counters);
+    };
+
+}
+
+#endif //CACHE_SIM_INTERVALS_HPP
@@ -1,14 +1,34 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <getopt.h> /* getopt() */
 #include "driver.hpp"
+#include "config_file.hpp"
+#include "binary_trace.hpp"
+#include "stack_distance.hpp"
+#include "belady.hpp"
+#include "sweep.hpp"
+#include "checkpoint.hpp"
+#include "intervals.hpp"
+#include "sampling.hpp"
+#include "collectors.hpp"
+#include "generator.hpp"
+#include "trace_reader.hpp"
 #include "errors.hpp"
 
 void usage() {
-    std::cerr << "usage: cache-sim [-hvd] -i input-file -c config-level -s associativity\n";
+    std::cerr << "usage: cache-sim [-hvdN] {-i input-file | -g generator} -c config-level -s associativity [-r policy] [-n inclusion] [-p threads]\n";
+    std::cerr << "       cache-sim [-hvdN] {-i input-file | -g generator} -f config-file [-r policy] [-n inclusion] [-p threads | -j threads]\n";
+    std::cerr << "       cache-sim convert -i input-file -o output-file [-a address-size]\n";
+    std::cerr << "       cache-sim stack-distance {-i input-file | -g generator} -b block-size -n sets [-w max-associativity]\n";
+    std::cerr << "       cache-sim opt {-i input-file | -g generator} -b block-size -n sets -w associativity [-r policies] [-m memory]\n";
+    std::cerr << "       cache-sim sweep {-i input-file | -g generator} -l level [-l level ...] [-j threads] [-o output-file]\n";
+    std::cerr << "       cache-sim intervals -i interval-file [-a intervals] [-s]\n";
 }
 
 void version() {
@@ -16,31 +36,530 @@ void version() {
 }
 
 void help () {
-    std::cerr << "usage: cache-sim [-hvd] -i input-file -c config-level -s associativity\n\n";
+    std::cerr << "usage: cache-sim [-hvdN] {-i input-file | -g generator} -c config-level -s associativity [-r policy] [-n inclusion] [-p threads]\n";
+    std::cerr << "       cache-sim [-hvdN] {-i input-file | -g generator} -f config-file [-r policy] [-n inclusion] [-p threads | -j threads]\n";
+    std::cerr << "                [-x collectors [-e csv|json]] [-k checkpoint-file -t reference] [-R checkpoint-file]\n";
+    std::cerr << "                [-S unit:period[:warm]] [-T interval -O interval-file]\n\n";
     std::cerr << "options:\n";
     std::cerr << "  -c, --config             configuration level: 1 | 2 | 3\n";
+    std::cerr << "  -f, --file               hierarchy configuration file instead of -c and -s,\n";
+    std::cerr << "                           with several hierarchies they are swept, one CSV row each\n";
     std::cerr << "  -s, --associativity      set associativity: divisible by 2\n";
-    std::cerr << "  -i, --input              input trace file\n";
-    std::cerr << "  -d, --debug\n";
+    std::cerr << "  -i, --input              input trace file, - for stdin\n";
+    std::cerr << "  -g, --generate           synthetic workload instead of -i, kind[:key=value ...]\n";
+    std::cerr << "                           seq | stride | uniform | zipf | chase | mixed, see README.md\n";
+    std::cerr << "  -r, --replacement        replacement policy per level, comma separated:\n";
+    std::cerr << "                           lru | plru | srrip | random | fifo | lfu, defaults to lru\n";
+    std::cerr << "  -n, --inclusion          inclusion policy per level, comma separated:\n";
+    std::cerr << "                           nine | inclusive | exclusive, defaults to nine\n";
+    std::cerr << "  -p, --partition          split the last level's sets across this many threads\n";
+    std::cerr << "  -j, --threads            worker threads of a configuration file sweep,\n";
+    std::cerr << "                           defaults to every hardware thread\n";
+    std::cerr << "  -x, --collect            statistics collected along, printed after the summary,\n";
+    std::cerr << "                           comma separated: heatmap | regions | ages\n";
+    std::cerr << "  -e, --export             format of the collected statistics: csv | json, defaults to csv\n";
+    std::cerr << "  -k, --checkpoint         file the state of every cache is saved to at the -t'th reference\n";
+    std::cerr << "  -t, --at                 reference the checkpoint of -k is taken at, 1 or more\n";
+    std::cerr << "  -R, --restore            checkpoint to start from, resuming the trace past its reference\n";
+    std::cerr << "  -S, --sample             measure `unit' references every `period', the `warm' before them\n";
+    std::cerr << "                           only warming the caches and the rest skipped (default: all warmed),\n";
+    std::cerr << "                           estimates miss rates and AMAT with 95% confidence intervals\n";
+    std::cerr << "  -T, --intervals          counters of every cache over every `N' references, or `Nc' simulated cycles,\n";
+    std::cerr << "                           written to the -O file as the run goes\n";
+    std::cerr << "  -O, --interval-file      file of the -T intervals, CSV if it ends in .csv, binary otherwise\n";
+    std::cerr << "  -N, --no-classify        don't split misses into compulsory, capacity and conflict\n";
+    std::cerr << "  -d, --debug              trace every cache access to stderr as CSV,\n";
+    std::cerr << "                           builds configured with -DCACHE_SIM_TRACING=ON\n";
     std::cerr << "  -h, --help\n";
-    std::cerr << "  -v, --version\n";
+    std::cerr << "  -v, --version\n\n";
+    std::cerr << "usage: cache-sim convert -i input-file -o output-file [-a address-size]\n\n";
+    std::cerr << "converts a text trace into the binary trace format, which -i accepts as well\n\n";
+    std::cerr << "options:\n";
+    std::cerr << "  -i, --input              input text trace file, - for stdin\n";
+    std::cerr << "  -o, --output             output binary trace file\n";
+    std::cerr << "  -a, --address-size       address width in bits, defaults to 32\n\n";
+    std::cerr << "usage: cache-sim stack-distance {-i input-file | -g generator} -b block-size -n sets [-w max-associativity]\n\n";
+    std::cerr << "one pass LRU stack distance analysis, hits and misses of a unified LRU cache\n";
+    std::cerr << "with the given sets and block size at every associativity up to max-associativity\n\n";
+    std::cerr << "options:\n";
+    std::cerr << "  -i, --input              input trace file, - for stdin\n";
+    std::cerr << "  -g, --generate           synthetic workload instead of -i\n";
+    std::cerr << "  -b, --block-size         block size in bytes\n";
+    std::cerr << "  -n, --sets               number of sets\n";
+    std::cerr << "  -w, --max-associativity  largest associativity reported, defaults to 64\n";
+    std::cerr << "  -a, --address-size       address width in bits, defaults to 32\n\n";
+    std::cerr << "usage: cache-sim opt {-i input-file | -g generator} -b block-size -n sets -w associativity [-r policies] [-m memory]\n\n";
+    std::cerr << "hits and misses of a unified cache under Belady's MIN, the offline optimal replacement,\n";
+    std::cerr << "next to the same cache under the given policies\n\n";
+    std::cerr << "options:\n";
+    std::cerr << "  -i, --input              input trace file, - for stdin\n";
+    std::cerr << "  -g, --generate           synthetic workload instead of -i\n";
+    std::cerr << "  -b, --block-size         block size in bytes\n";
+    std::cerr << "  -n, --sets               number of sets\n";
+    std::cerr << "  -w, --associativity      set associativity\n";
+    std::cerr << "  -r, --replacement        policies compared with MIN, comma separated, defaults to lru\n";
+    std::cerr << "  -m, --memory             MiB of the recorded trace kept in memory, past it spilled\n";
+    std::cerr << "                           to files under $TMPDIR, defaults to 1024\n";
+    std::cerr << "  -a, --address-size       address width in bits, defaults to 32\n\n";
+    std::cerr << "usage: cache-sim sweep {-i input-file | -g generator} {-l level [-l level ...] | -f config-file} [-j threads] [-o output-file]\n\n";
+    std::cerr << "simulates every combination of the level grids over one decoded trace,\n";
+    std::cerr << "one CSV row per hierarchy\n\n";
+    std::cerr << "options:\n";
+    std::cerr << "  -i, --input              input trace file, - for stdin\n";
+    std::cerr << "  -g, --generate           synthetic workload instead of -i\n";
+    std::cerr << "  -l, --level              grid of the next level,\n";
+    std::cerr << "                           size:block:associativity:write[:replacement[:inclusion]]\n";
+    std::cerr << "                           every field a comma separated list, write is wb | wt\n";
+    std::cerr << "  -f, --file               hierarchies of a configuration file, swept along with the grid\n";
+    std::cerr << "  -j, --threads            worker threads, defaults to every hardware thread\n";
+    std::cerr << "  -o, --output             CSV output file, defaults to stdout\n\n";
+    std::cerr << "usage: cache-sim intervals -i interval-file [-a intervals] [-s]\n\n";
+    std::cerr << "prints a binary interval file of -T as CSV, or sums it up\n\n";
+    std::cerr << "options:\n";
+    std::cerr << "  -i, --input              binary interval file\n";
+    std::cerr << "  -a, --aggregate          intervals merged into each row, defaults to 1\n";
+    std::cerr << "  -s, --summary            totals of every cache and the spread of its interval miss rates\n";
+}
+
+/*
+ * the trace of -i, or the generator of -g instead
+ */
+cs::TraceSource *source(const char *input, const char *generate) {
+    if ((input == nullptr) == (generate == nullptr))
+        throw CSException(input == nullptr ? "invalid input file" : "-i and -g are mutually exclusive");
+    if (generate != nullptr)
+        return cs::Generator::create(generate);
+    return cs::TraceSource::open(input, true);
+}
+
+/*
+ * `convert' subcommand, text trace to binary trace
+ */
+int convert(int argc, char *argv[]) {
+    const char *input = nullptr, *output = nullptr;
+    unsigned address_size = 32;
+
+    static struct option longopts[] {
+            { "input", required_argument, nullptr, 'i'},
+            { "output", required_argument, nullptr, 'o'},
+            { "address-size", required_argument, nullptr, 'a'},
+            {nullptr, 0, nullptr, 0}
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "i:o:a:", longopts, nullptr)) != -1) {
+        switch (ch) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'a':
+                address_size = std::stoi(optarg, 0);
+                break;
+            default:
+                usage();
+                exit(1);
+        }
+    }
+
+    if (input == nullptr)
+        throw CSException("invalid input file");
+    if (output == nullptr)
+        throw CSException("invalid output file");
+    if (address_size == 0 || address_size > 64)
+        throw CSException("invalid address size");
+
+    cs::TraceReader trace(input);
+    cs::BinaryTraceWriter writer(output, address_size);
+    cs::Reference ref;
+    while (trace.next(ref)) {
+        if (address_size < 64 && (ref.address >> address_size) != 0)
+            throw InvalidLine(trace.line(), "address wider than " + std::to_string(address_size) + "-bit");
+        writer.write(ref);
+    }
+    writer.close();
+    return 0;
+}
+
+/*
+ * `stack-distance' subcommand, every associativity of an LRU cache in one pass
+ */
+int stack_distance(int argc, char *argv[]) {
+    const char *input = nullptr, *generate = nullptr;
+    int block_size = 0, num_sets = 0, max_ways = 64;
+    unsigned address_size = 32;
+
+    static struct option longopts[] {
+            { "input", required_argument, nullptr, 'i'},
+            { "generate", required_argument, nullptr, 'g'},
+            { "block-size", required_argument, nullptr, 'b'},
+            { "sets", required_argument, nullptr, 'n'},
+            { "max-associativity", required_argument, nullptr, 'w'},
+            { "address-size", required_argument, nullptr, 'a'},
+            {nullptr, 0, nullptr, 0}
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "i:g:b:n:w:a:", longopts, nullptr)) != -1) {
+        switch (ch) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'g':
+                generate = optarg;
+                break;
+            case 'b':
+                block_size = std::stoi(optarg, 0);
+                break;
+            case 'n':
+                num_sets = std::stoi(optarg, 0);
+                break;
+            case 'w':
+                max_ways = std::stoi(optarg, 0);
+                break;
+            case 'a':
+                address_size = std::stoi(optarg, 0);
+                break;
+            default:
+                usage();
+                exit(1);
+        }
+    }
+
+    if (block_size <= 0 || num_sets <= 0)
+        throw CSException("invalid block size or number of sets");
+
+    cs::StackDistance profile(block_size, num_sets, max_ways, address_size);
+    std::unique_ptr<cs::TraceSource> trace(source(input, generate));
+    const cs::Reference *batch;
+    size_t n;
+    while ((n = trace->next_batch(batch)) != 0) {
+        for (size_t i = 0; i < n; i++)
+            profile.access(batch[i].address);
+    }
+    profile.summary(std::cout);
+    return 0;
+}
+
+/*
+ * `opt' subcommand, Belady's MIN against the usual policies
+ */
+int opt(int argc, char *argv[]) {
+    const char *input = nullptr, *generate = nullptr;
+    int block_size = 0, num_sets = 0, ways = 0;
+    unsigned address_size = 32;
+    size_t memory = 1024;
+    std::string replacement = "lru";
+
+    static struct option longopts[] {
+            { "input", required_argument, nullptr, 'i'},
+            { "generate", required_argument, nullptr, 'g'},
+            { "block-size", required_argument, nullptr, 'b'},
+            { "sets", required_argument, nullptr, 'n'},
+            { "associativity", required_argument, nullptr, 'w'},
+            { "replacement", required_argument, nullptr, 'r'},
+            { "memory", required_argument, nullptr, 'm'},
+            { "address-size", required_argument, nullptr, 'a'},
+            {nullptr, 0, nullptr, 0}
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "i:g:b:n:w:r:m:a:", longopts, nullptr)) != -1) {
+        switch (ch) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'g':
+                generate = optarg;
+                break;
+            case 'b':
+                block_size = std::stoi(optarg, 0);
+                break;
+            case 'n':
+                num_sets = std::stoi(optarg, 0);
+                break;
+            case 'w':
+                ways = std::stoi(optarg, 0);
+                break;
+            case 'r':
+                replacement = optarg;
+                break;
+            case 'm':
+                memory = std::stoull(optarg, 0);
+                break;
+            case 'a':
+                address_size = std::stoi(optarg, 0);
+                break;
+            default:
+                usage();
+                exit(1);
+        }
+    }
+
+    if (block_size <= 0 || num_sets <= 0 || ways <= 0)
+        throw CSException("invalid block size, number of sets or associativity");
+
+    std::vector<std::string> policies;
+    for (size_t begin = 0; replacement != "" && begin != std::string::npos; ) {
+        size_t end = replacement.find(',', begin);
+        policies.push_back(replacement.substr(begin, end == std::string::npos ? end : end - begin));
+        begin = end == std::string::npos ? end : end + 1;
+    }
+
+    cs::Belady min(block_size, num_sets, ways, address_size, policies, memory << 20);
+    std::unique_ptr<cs::TraceSource> trace(source(input, generate));
+    const cs::Reference *batch;
+    size_t n;
+    while ((n = trace->next_batch(batch)) != 0) {
+        for (size_t i = 0; i < n; i++)
+            min.access(batch[i].address);
+    }
+    min.run();
+    min.summary(std::cout);
+    return 0;
+}
+
+/*
+ * `sweep' subcommand, a grid of hierarchies over one shared trace
+ */
+int sweep(int argc, char *argv[]) {
+    const char *input = nullptr, *generate = nullptr, *output = nullptr, *file = nullptr;
+    std::vector<std::string> levels;
+    int threads = 0;
+
+    static struct option longopts[] {
+            { "input", required_argument, nullptr, 'i'},
+            { "generate", required_argument, nullptr, 'g'},
+            { "level", required_argument, nullptr, 'l'},
+            { "file", required_argument, nullptr, 'f'},
+            { "threads", required_argument, nullptr, 'j'},
+            { "output", required_argument, nullptr, 'o'},
+            {nullptr, 0, nullptr, 0}
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "i:g:l:f:j:o:", longopts, nullptr)) != -1) {
+        switch (ch) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'g':
+                generate = optarg;
+                break;
+            case 'l':
+                levels.push_back(optarg);
+                break;
+            case 'f':
+                file = optarg;
+                break;
+            case 'j':
+                threads = std::stoi(optarg, 0);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage();
+                exit(1);
+        }
+    }
+
+    if (levels.empty() && file == nullptr)
+        throw CSException("no sweep levels given");
+
+    /* the configuration file's hierarchies first, by name, then the grid */
+    std::vector<std::vector<cs::config>> hierarchies;
+    std::vector<std::string> names;
+    if (file != nullptr) {
+        cs::ConfigFile configuration(file);
+        hierarchies = configuration.hierarchies();
+        names = configuration.names();
+    }
+    if (!levels.empty()) {
+        for (auto& hierarchy : cs::Sweep::grid(levels)) {
+            names.push_back(std::to_string(hierarchies.size()));
+            hierarchies.push_back(hierarchy);
+        }
+    }
+
+    cs::Sweep sweep(hierarchies, threads, names);
+    cs::DecodedTrace trace(source(input, generate));
+    sweep.run(trace.data(), trace.size());
+
+    if (output != nullptr) {
+        std::ofstream out(output);
+        if (!out.is_open())
+            throw CSException("invalid output file");
+        sweep.report(out);
+    } else {
+        sweep.report(std::cout);
+    }
+    return 0;
+}
+
+/*
+ * `intervals' subcommand, a binary interval file as CSV, every `aggregate' intervals merged, or summed up
+ */
+int intervals(int argc, char *argv[]) {
+    const char *input = nullptr;
+    uint64_t aggregate = 1;
+    bool summary = false;
+
+    static struct option longopts[] {
+            { "input", required_argument, nullptr, 'i'},
+            { "aggregate", required_argument, nullptr, 'a'},
+            { "summary", no_argument, nullptr, 's'},
+            {nullptr, 0, nullptr, 0}
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "i:a:s", longopts, nullptr)) != -1) {
+        switch (ch) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'a':
+                aggregate = std::stoull(optarg, 0);
+                break;
+            case 's':
+                summary = true;
+                break;
+            default:
+                usage();
+                exit(1);
+        }
+    }
+
+    if (input == nullptr)
+        throw CSException("invalid interval file");
+    if (aggregate == 0)
+        throw CSException("invalid number of intervals to aggregate");
+
+    cs::IntervalReader reader(input);
+    const std::vector<cs::IntervalCache>& caches = reader.caches();
+    size_t words = 3 * caches.size();
+    std::vector<uint64_t> counters(words, 0), merged(words, 0), total(words, 0);
+    std::vector<double> min_rate(caches.size(), 1.0), max_rate(caches.size(), 0.0);
+    uint64_t first, references, merged_first = 0, merged_references = 0, merged_count = 0, rows = 0, count = 0;
+    uint64_t total_references = 0;
+    std::string out;
+    if (!summary)
+        cs::interval_csv_header(out, caches);
+
+    auto flush = [&]() {
+        if (!summary)
+            cs::interval_csv_row(out, caches, rows, merged_first, merged_references, merged.data());
+        rows++;
+        std::fill(merged.begin(), merged.end(), 0);
+        merged_references = 0;
+        merged_count = 0;
+        std::cout << out;
+        out.clear();
+    };
+
+    while (reader.next(first, references, counters.data())) {
+        if (merged_count == 0)
+            merged_first = first;
+        merged_references += references;
+        total_references += references;
+        for (size_t i = 0; i < words; i++) {
+            merged[i] += counters[i];
+            total[i] += counters[i];
+        }
+        for (size_t c = 0; c < caches.size(); c++) {
+            uint64_t accesses = counters[3 * c] + counters[3 * c + 1];
+            if (accesses == 0)
+                continue;
+            double rate = static_cast<double>(counters[3 * c + 1]) / static_cast<double>(accesses);
+            min_rate[c] = std::min(min_rate[c], rate);
+            max_rate[c] = std::max(max_rate[c], rate);
+        }
+        count++;
+        if (++merged_count == aggregate)
+            flush();
+    }
+    if (merged_count != 0)
+        flush();
+    if (!summary)
+        return 0;
+
+    /* the whole run, and how far its intervals strayed from it */
+    double amat = cs::interval_amat(caches, total.data());
+    std::cout << "intervals: " << count << " of " << reader.spec().length
+              << (reader.spec().unit == cs::INTERVAL_CYCLES ? " cycles" : " references") << "\n";
+    std::cout << "references: " << total_references << "\n";
+    std::cout << "AMAT: " << amat << "\n";
+    for (size_t c = 0; c < caches.size(); c++) {
+        uint64_t hits = total[3 * c], misses = total[3 * c + 1];
+        double rate = hits + misses == 0 ? 0.0 : static_cast<double>(misses) / static_cast<double>(hits + misses);
+        std::cout << "\n" << caches[c].name << "\n";
+        std::cout << "  hits: " << hits << "\n";
+        std::cout << "  misses: " << misses << "\n";
+        std::cout << "  writebacks: " << total[3 * c + 2] << "\n";
+        std::cout << "  miss rate: " << rate;
+        if (min_rate[c] <= max_rate[c])
+            std::cout << " (intervals " << min_rate[c] << " to " << max_rate[c] << ")";
+        std::cout << "\n";
+    }
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
     int status = 1;
-    bool debug = false;
+    bool debug = false, classify = true;
     try {
 
+        if (argc > 1 && strcmp(argv[1], "convert") == 0) {
+            status = convert(argc - 1, argv + 1);
+            exit(status);
+        }
+        if (argc > 1 && strcmp(argv[1], "stack-distance") == 0) {
+            status = stack_distance(argc - 1, argv + 1);
+            exit(status);
+        }
+        if (argc > 1 && strcmp(argv[1], "opt") == 0) {
+            status = opt(argc - 1, argv + 1);
+            exit(status);
+        }
+        if (argc > 1 && strcmp(argv[1], "sweep") == 0) {
+            status = sweep(argc - 1, argv + 1);
+            exit(status);
+        }
+        if (argc > 1 && strcmp(argv[1], "intervals") == 0) {
+            status = intervals(argc - 1, argv + 1);
+            exit(status);
+        }
+
     /*
      * parsing options
      */
-        std::ifstream in;
-        std::string config, set = "";
+        const char *input = nullptr, *generate = nullptr, *file = nullptr, *checkpoint = nullptr, *restore = nullptr,
+                *sample = nullptr, *interval = nullptr, *interval_file = nullptr;
+        uint64_t checkpoint_at = 0;
+        std::string config, set = "", replacement = "", inclusion = "", collect = "", format = "csv";
+        int partitions = 0, threads = 0;
 
         static struct option longopts[] {
                 { "config", required_argument, nullptr, 'c'},
+                { "file", required_argument, nullptr, 'f'},
                 { "associativity", required_argument, nullptr, 's'},
                 { "input", required_argument, nullptr, 'i'},
+                { "generate", required_argument, nullptr, 'g'},
+                { "replacement", required_argument, nullptr, 'r'},
+                { "inclusion", required_argument, nullptr, 'n'},
+                { "partition", required_argument, nullptr, 'p'},
+                { "threads", required_argument, nullptr, 'j'},
+                { "collect", required_argument, nullptr, 'x'},
+                { "export", required_argument, nullptr, 'e'},
+                { "checkpoint", required_argument, nullptr, 'k'},
+                { "at", required_argument, nullptr, 't'},
+                { "restore", required_argument, nullptr, 'R'},
+                { "sample", required_argument, nullptr, 'S'},
+                { "intervals", required_argument, nullptr, 'T'},
+                { "interval-file", required_argument, nullptr, 'O'},
+                { "no-classify", no_argument, nullptr, 'N'},
                 { "debug", no_argument, nullptr, 'd'},
                 { "help", no_argument, nullptr, 'h'},
                 { "version", no_argument, nullptr, 'v'},
@@ -48,20 +567,73 @@ int main(int argc, char *argv[]) {
         };
 
         int ch;
-        while ((ch = getopt_long(argc, argv, "hvds:c:i:", longopts, nullptr)) != -1) {
+        while ((ch = getopt_long(argc, argv, "hvdNs:c:f:i:g:r:n:p:j:x:e:k:t:R:S:T:O:", longopts, nullptr)) != -1) {
             switch (ch) {
                 case 'c':
                     config = optarg;
                     break;
+                case 'f':
+                    file = optarg;
+                    break;
                 case 's':
                     set = optarg;
                     break;
                 case 'i':
-                    in.open(optarg);
+                    input = optarg;
+                    break;
+                case 'g':
+                    generate = optarg;
+                    break;
+                case 'r':
+                    replacement = optarg;
+                    break;
+                case 'n':
+                    inclusion = optarg;
+                    break;
+                case 'p':
+                    partitions = std::stoi(optarg, 0);
+                    if (partitions <= 0)
+                        throw CSException("invalid number of partitions");
+                    break;
+                case 'j':
+                    threads = std::stoi(optarg, 0);
+                    if (threads <= 0)
+                        throw CSException("invalid number of threads");
+                    break;
+                case 'x':
+                    collect = optarg;
+                    break;
+                case 'e':
+                    format = optarg;
+                    if (format != "csv" && format != "json")
+                        throw CSException("invalid export format -- csv | json");
+                    break;
+                case 'k':
+                    checkpoint = optarg;
+                    break;
+                case 't':
+                    checkpoint_at = std::stoull(optarg, 0);
+                    if (checkpoint_at == 0)
+                        throw CSException("-t must be 1 or more, the checkpoint is taken after that many references");
+                    break;
+                case 'R':
+                    restore = optarg;
+                    break;
+                case 'S':
+                    sample = optarg;
+                    break;
+                case 'T':
+                    interval = optarg;
+                    break;
+                case 'O':
+                    interval_file = optarg;
                     break;
                 case 'd':
                     debug = true;
                     break;
+                case 'N':
+                    classify = false;
+                    break;
                 case 'v':
                     version();
                     exit(0);
@@ -74,69 +646,218 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        if (!in.is_open()) {
-            throw CSException("invalid input file");
-        }
+        if (debug && !cs::TRACING)
+            throw CSException("-d needs tracing, configure with -DCACHE_SIM_TRACING=ON");
+        if (debug && partitions > 0)
+            throw CSException("-d traces a sequential run, it can't be combined with -p");
+        if (collect != "" && partitions > 0)
+            throw CSException("-x collects from a sequential run, it can't be combined with -p");
+        if ((checkpoint != nullptr || restore != nullptr) && partitions > 0)
+            throw CSException("checkpoints are taken of sequential runs, they can't be combined with -p");
+        if ((checkpoint == nullptr) != (checkpoint_at == 0))
+            throw CSException("-k and -t go together, a checkpoint file and the reference to take it at");
+        if (sample != nullptr && (debug || collect != "" || partitions > 0 || checkpoint != nullptr || restore != nullptr))
+            throw CSException("-S only measures samples of the trace, it can't be combined with -d, -x, -p, -k or -R");
+        if ((interval == nullptr) != (interval_file == nullptr))
+            throw CSException("-T and -O go together, an interval and the file its records are written to");
+        if (interval != nullptr && (partitions > 0 || sample != nullptr))
+            throw CSException("-T records intervals of a sequential run, it can't be combined with -p or -S");
 
-        if (set == "") {
-            throw CSException("invalid set associativity");
+        /* collectors named by -x */
+        std::vector<std::unique_ptr<cs::Collector>> collectors;
+        for (size_t begin = 0; collect != "" && begin != std::string::npos; ) {
+            size_t end = collect.find(',', begin);
+            collectors.emplace_back(cs::Collector::create(
+                    collect.substr(begin, end == std::string::npos ? end : end - begin)));
+            begin = end == std::string::npos ? end : end + 1;
         }
 
+        /*
+         * -r and -n override the policies of every level, comma separated per level,
+         * levels past the end of a list use the last one given
+         */
+        auto override = [&](std::vector<cs::config>& configs) {
+            if (replacement != "") {
+                size_t begin = 0;
+                for (auto& level : configs) {
+                    size_t end = replacement.find(',', begin);
+                    level.replacement = replacement.substr(begin, end == std::string::npos ? end : end - begin);
+                    if (end != std::string::npos)
+                        begin = end + 1;
+                }
+            }
+
+            if (inclusion != "") {
+                size_t begin = 0;
+                for (auto& level : configs) {
+                    size_t end = inclusion.find(',', begin);
+                    level.inclusion = cs::inclusion_policy(
+                            inclusion.substr(begin, end == std::string::npos ? end : end - begin));
+                    if (end != std::string::npos)
+                        begin = end + 1;
+                }
+            }
+        };
+
         std::vector<cs::config> configs;
-        if (config == "1") {
-            int num_sets = std::stoi(set, 0);
-            configs = {
-                    {cs::write_through, cs::write_through, 1024, 32, 32, 1, 100, num_sets, debug}
-            };
-        } else if (config == "2") {
-            int num_sets = std::stoi(set, 0);
-            configs = {
-                    {cs::write_back, cs::write_back, 1024, 32, 32, 1, 100, num_sets, debug}
-            };
-        } else if (config == "3") {
-            int num_sets = std::stoi(set, 0);
-            configs = {
-                    {cs::write_back, cs::write_back, 1024, 32, 32, 1, 100, 2, debug},
-                    {0,              cs::write_back, 16384, 128, 32, 1, 100, num_sets, debug}
-            };
+        if (file != nullptr) {
+            if (config != "")
+                throw CSException("-c and -f are mutually exclusive");
+            cs::ConfigFile configuration(file);
+            if (configuration.size() > 1) {
+                if (debug || !collectors.empty() || checkpoint != nullptr || restore != nullptr || sample != nullptr ||
+                        interval != nullptr)
+                    throw CSException("-d, -x, -k, -R, -S and -T need a single hierarchy, not a sweep");
+                if (partitions > 0)
+                    throw CSException("-p partitions a single hierarchy, a sweep takes its threads from -j");
+                /* several hierarchies, swept over one decoded trace */
+                std::vector<std::vector<cs::config>> hierarchies = configuration.hierarchies();
+                for (auto& hierarchy : hierarchies)
+                    override(hierarchy);
+                cs::Sweep sweep(hierarchies, threads, configuration.names());
+                cs::DecodedTrace decoded(source(input, generate));
+                sweep.run(decoded.data(), decoded.size());
+                sweep.report(std::cout);
+                exit(0);
+            }
+            configs = configuration.hierarchies()[0];
         } else {
-            throw CSException("invalid configuration");
+            if (set == "") {
+                throw CSException("invalid set associativity");
+            }
+            if (config == "1") {
+                int num_sets = std::stoi(set, 0);
+                configs = {
+                        {cs::write_through, cs::write_through, 1024, 32, 32, 1, 100, num_sets, "", cs::nine, false}
+                };
+            } else if (config == "2") {
+                int num_sets = std::stoi(set, 0);
+                configs = {
+                        {cs::write_back, cs::write_back, 1024, 32, 32, 1, 100, num_sets, "", cs::nine, false}
+                };
+            } else if (config == "3") {
+                int num_sets = std::stoi(set, 0);
+                configs = {
+                        {cs::write_back, cs::write_back, 1024, 32, 32, 1, 100, 2, "", cs::nine, false},
+                        {0,              cs::write_back, 16384, 128, 32, 1, 100, num_sets, "", cs::nine, false}
+                };
+            } else {
+                throw CSException("invalid configuration");
+            }
         }
+        override(configs);
+        if (threads > 0)
+            throw CSException("-j sets the threads of a configuration file sweep, -p partitions a single hierarchy");
 
         /*
          * creating cache driver
          */
         cs::CacheDriver cache_wt(configs);
+        cache_wt.classify(classify);
 
-        std::string line;
-        while (getline(in, line)) {
-            std::string type = line.substr(0, line.find(' '));
-            std::string addr = line.substr(line.find(' ') + 1);
-            if (type == "" || addr == "") {
-                std::string str = "invalid line -- " + line;
-                throw CSException(str.c_str());
-            }
+        if (partitions > 0) {
+            /* the last level's sets split across threads, needs the whole trace up front */
+            cs::DecodedTrace decoded(source(input, generate));
+            cache_wt.exec_partitioned(decoded.data(), decoded.size(), partitions);
+            cache_wt.summary(std::cout);
+            exit(0);
+        }
 
-            if (type == "0") {
-                if (debug) {
-                    std::cerr << "[data read] "<< addr << "\n";
-                }
-                (void) cache_wt.exec(0, addr);
+        if (sample != nullptr) {
+            /* counters of the sampled units, then what they project for the whole trace */
+            cs::SampledRun sampled(cache_wt, cs::SamplingPlan::parse(sample));
+            std::unique_ptr<cs::TraceSource> trace(source(input, generate));
+            sampled.run(*trace);
+            cache_wt.summary(std::cout);
+            std::cout << "\n";
+            sampled.summary(std::cout);
+            exit(0);
+        }
 
-            } else if (type == "1") {
-                if (debug) {
-                    std::cerr << "[data write] " << addr << "\n";
-                }
-                (void) cache_wt.exec(1, addr);
+        for (auto& collector : collectors)
+            cache_wt.observe(collector.get());
+        std::unique_ptr<cs::TraceSink> sink;
+        if (debug) {
+            sink.reset(new cs::TraceSink(std::cerr));
+            cache_wt.trace(sink.get());
+        }
+        /* picks up where a checkpoint left off, seeking past what it covers or reading past it */
+        uint64_t position = 0, skip = 0;
+        if (restore != nullptr)
+            position = cs::Checkpoint::restore(cache_wt, restore);
+        if (checkpoint != nullptr && checkpoint_at <= position)
+            throw CSException("-t must be past the restored checkpoint");
+        std::unique_ptr<cs::IntervalRecorder> recorder;
+        if (interval != nullptr)
+            recorder.reset(new cs::IntervalRecorder(cache_wt, cs::IntervalSpec::parse(interval), interval_file, position));
 
-            } else if (type == "2") {
-                if (debug) {
-                    std::cerr << "[instruction read] " << addr << "\n";
-                }
-                (void) cache_wt.exec(2, addr);
+        /* opened once everything else checked out, a pipelined reader may block on its input until it ends */
+        std::unique_ptr<cs::TraceSource> trace(source(input, generate));
+        if (restore != nullptr)
+            skip = position - trace->seek(position);
+
+        auto run = [&](const cs::Reference *refs, size_t count) {
+            if (!debug) {
+                (void) cache_wt.exec(refs, count);
+                return;
+            }
+            /* one reference at a time, so its events follow it */
+            for (size_t i = 0; i < count; i++) {
+                sink->reference(refs[i].type, refs[i].address);
+                (void) cache_wt.exec(refs[i].type, refs[i].address);
+            }
+        };
+
+        const cs::Reference *batch;
+        size_t n;
+        while ((n = trace->next_batch(batch)) != 0) {
+            if (skip != 0) {
+                size_t k = skip < n ? static_cast<size_t>(skip) : n;
+                batch += k;
+                n -= k;
+                skip -= k;
+            }
+            /* in steps that end at the checkpoint reference and at every interval boundary */
+            while (n != 0) {
+                size_t k = n;
+                if (checkpoint != nullptr && position < checkpoint_at && checkpoint_at - position < k)
+                    k = static_cast<size_t>(checkpoint_at - position);
+                if (recorder && recorder->room() < k)
+                    k = static_cast<size_t>(recorder->room());
+                run(batch, k);
+                batch += k;
+                n -= k;
+                position += k;
+                if (checkpoint != nullptr && position == checkpoint_at)
+                    cs::Checkpoint::save(cache_wt, checkpoint_at, checkpoint);
+                if (recorder)
+                    recorder->advance(k);
             }
         }
+        if (skip != 0)
+            throw CSException("the trace ends before the restored checkpoint");
+        if (checkpoint != nullptr && position < checkpoint_at)
+            throw CSException("the trace ends before the checkpoint reference");
+        if (sink)
+            sink->flush();
+        if (recorder)
+            recorder->finish();
         cache_wt.summary(std::cout);
+
+        /* collected statistics after the summary, a CSV table each or one JSON object */
+        if (format == "json" && !collectors.empty()) {
+            std::cout << "{";
+            for (size_t c = 0; c < collectors.size(); c++) {
+                std::cout << (c != 0 ? ", " : "") << "\"" << collectors[c]->name() << "\": ";
+                collectors[c]->json(std::cout);
+            }
+            std::cout << "}\n";
+        } else {
+            for (auto& collector : collectors) {
+                std::cout << "\n";
+                collector->csv(std::cout);
+            }
+        }
         status = 0;
     } catch (std::exception& ex) {
         std::cerr << ex.what() << "\n";
@@ -0,0 +1,78 @@
+/*
+ * Three-C miss classification definition
+ */
+
+#include "miss_classifier.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace cs {
+
+    MissClassifier::MissClassifier(size_t lines)
+            : _lines(static_cast<uint32_t>(lines)), _size(0), _entries(nullptr), _links(nullptr), _count(0) {
+        _entries = static_cast<size_t *>(std::calloc(lines, sizeof(size_t)));
+        _links = static_cast<Link *>(std::calloc(lines + 1, sizeof(Link)));
+        if (_entries == nullptr || _links == nullptr) {
+            std::free(_entries);
+            std::free(_links);
+            throw std::bad_alloc();
+        }
+        _links[_lines] = Link{_lines, _lines};
+
+        /* at most half full, so probes stay short, and grown with the blocks touched past 2^16 entries */
+        unsigned bits = 4;
+        while ((size_t(1) << bits) < 2 * lines && bits < 16)
+            bits++;
+        _table.assign(size_t(1) << bits, Entry{EMPTY, NONE});
+        _shift = 64 - bits;
+    }
+
+    MissClassifier::~MissClassifier() {
+        std::free(_entries);
+        std::free(_links);
+    }
+
+    void MissClassifier::grow() {
+        std::vector<Entry> old(_table.size() * 2, Entry{EMPTY, NONE});
+        old.swap(_table);
+        _shift--;
+        size_t mask = _table.size() - 1;
+        for (const Entry& entry : old) {
+            if (entry.block == EMPTY)
+                continue;
+            size_t i = hash(entry.block, _shift);
+            while (_table[i].block != EMPTY)
+                i = (i + 1) & mask;
+            _table[i] = entry;
+            if (entry.slot != NONE)
+                _entries[entry.slot] = i;
+        }
+    }
+
+    std::vector<StateSpan> MissClassifier::state() {
+        return {
+                {&_size, sizeof(_size)},
+                {&_count, sizeof(_count)},
+                {_entries, _lines * sizeof(size_t)},
+                {_links, (_lines + size_t(1)) * sizeof(Link)},
+                {_table.data(), _table.size() * sizeof(Entry)}
+        };
+    }
+
+    void MissClassifier::resize_table(unsigned bits) {
+        _table.assign(size_t(1) << bits, Entry{EMPTY, NONE});
+        _shift = 64 - bits;
+    }
+
+    void MissClassifier::drain(uint64_t counts[3]) {
+        size_t n = _deferred.size();
+        for (size_t i = 0; i < n; i++) {
+            if (i + PREFETCH < n)
+                __builtin_prefetch(&_table[hash(_deferred[i + PREFETCH].block, _shift)]);
+            int c = access(_deferred[i].block, _deferred[i].hit);
+            if (c != MISS_NONE)
+                counts[c]++;
+        }
+        _deferred.clear();
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * Three-C miss classification,
+ * every miss of a cache told apart as compulsory, capacity or conflict
+ */
+
+#ifndef CACHE_SIM_MISS_CLASSIFIER_HPP
+#define CACHE_SIM_MISS_CLASSIFIER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "replacement.hpp"
+
+namespace cs {
+
+    enum miss_class {
+        MISS_NONE = -1, /* the access hit */
+        MISS_COMPULSORY, /* first touch of the block */
+        MISS_CAPACITY, /* a fully associative LRU cache of the same size misses it too */
+        MISS_CONFLICT /* only the set mapping lost it */
+    };
+
+/*
+ * sees every access of a cache, hits included,
+ * through a shadow fully associative LRU cache of as many lines and a set of every block touched
+ *
+ * both share one open addressing hash table of every block touched, which never drops one:
+ * an entry holds the shadow line caching its block, if any, and each shadow line its entry,
+ * so a shadow eviction only clears an entry and an access is one lookup and a few list links
+ * shadow lines are linked from most to least recently used in flat arrays
+ */
+    class MissClassifier {
+        static const uint32_t NONE = UINT32_MAX;
+        static const uint64_t EMPTY = ~uint64_t(0); /* never a block address, see Cache::INVALID_TAG */
+
+        struct Entry {
+            uint64_t block;
+            uint32_t slot; /* shadow line holding block, NONE if the shadow doesn't */
+        };
+
+        struct Deferred {
+            uint64_t block;
+            bool hit;
+        };
+
+        static const size_t PREFETCH = 8; /* accesses ahead whose table entries drain() prefetches */
+
+        struct Link {
+            uint32_t prev, next;
+        };
+
+        /*
+         * shadow lines 0 .. _lines - 1, in a circle through the sentinel _lines, most recently used first
+         * zeroed by calloc, so only the pages of the lines filled so far are ever materialized
+         */
+        uint32_t _lines, _size;
+        size_t *_entries; /* by line, the table entry of its block */
+        Link *_links;
+
+        /* every block touched, linear probing */
+        std::vector<Entry> _table;
+        unsigned _shift;
+        size_t _count;
+
+        static size_t hash(uint64_t block, unsigned shift) {
+            return static_cast<size_t>((block * 0x9e3779b97f4a7c15ull) >> shift);
+        }
+
+        void unlink(uint32_t slot) {
+            _links[_links[slot].prev].next = _links[slot].next;
+            _links[_links[slot].next].prev = _links[slot].prev;
+        }
+
+        void push_front(uint32_t slot) {
+            uint32_t first = _links[_lines].next;
+            _links[slot] = Link{_lines, first};
+            _links[first].prev = slot;
+            _links[_lines].next = slot;
+        }
+
+        /* doubles the table, rehashing every block and repointing the shadow lines */
+        void grow();
+
+        std::vector<Deferred> _deferred;
+
+    public:
+        static const uint64_t MAX_LINES = UINT32_MAX - 1; /* lines must be fewer, slots are 32-bit */
+
+        /* lines of the cache being classified */
+        explicit MissClassifier(size_t lines);
+        ~MissClassifier();
+
+        MissClassifier(const MissClassifier&) = delete;
+        MissClassifier& operator=(const MissClassifier&) = delete;
+
+    /*
+     * an access to the block at block address `block' that hit or missed in the cache,
+     * returns the class of a miss, MISS_NONE for a hit
+     */
+        int access(uint64_t block, bool hit);
+
+    /*
+     * every array of its state for checkpoints, the table last, 2^table_bits() entries of it
+     */
+        std::vector<StateSpan> state();
+        unsigned table_bits() const { return 64 - _shift; }
+        static size_t table_bytes(unsigned bits) { return sizeof(Entry) << bits; }
+
+        /* an empty table of 2^bits entries, for a checkpoint's to be restored into */
+        void resize_table(unsigned bits);
+
+    /*
+     * queues an access for drain(), which classifies a batch of them
+     * prefetching the table entries ahead, so large footprints don't stall on each lookup
+     */
+        void defer(uint64_t block, bool hit) { _deferred.push_back(Deferred{block, hit}); }
+
+    /*
+     * classifies every queued access in order, adding the misses of each class to counts[class]
+     */
+        void drain(uint64_t counts[3]);
+    };
+
+    inline int MissClassifier::access(uint64_t block, bool hit) {
+        size_t mask = _table.size() - 1;
+        size_t i = hash(block, _shift);
+        while (_table[i].block != block && _table[i].block != EMPTY)
+            i = (i + 1) & mask;
+
+        bool first = _table[i].block == EMPTY;
+        uint32_t slot = first ? NONE : _table[i].slot;
+        if (slot != NONE) {
+            unlink(slot);
+            push_front(slot);
+            return hit ? MISS_NONE : MISS_CONFLICT;
+        }
+
+        /* the shadow misses too, it takes the block in over its least recently used line */
+        if (_size < _lines) {
+            slot = _size++;
+        } else {
+            slot = _links[_lines].prev;
+            _table[_entries[slot]].slot = NONE;
+            unlink(slot);
+        }
+        push_front(slot);
+        _table[i] = Entry{block, slot};
+        _entries[slot] = i;
+        if (first && ++_count * 2 > _table.size())
+            grow();
+
+        if (hit)
+            return MISS_NONE;
+        return first ? MISS_COMPULSORY : MISS_CAPACITY;
+    }
+
+}
+
+#endif //CACHE_SIM_MISS_CLASSIFIER_HPP
@@ -0,0 +1,65 @@
+/*
+ * Cache observers,
+ * hooks that see every hit, miss, fill, eviction and writeback of a cache
+ */
+
+#ifndef CACHE_SIM_OBSERVER_HPP
+#define CACHE_SIM_OBSERVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace cs {
+
+    class Cache;
+
+    enum event_kind {
+        EVENT_HIT,
+        EVENT_MISS,
+        EVENT_FILL, /* a block brought in, by a miss or handed down from above */
+        EVENT_EVICT, /* a valid block pushed out or invalidated */
+        EVENT_WRITEBACK /* the evicted block was dirty, follows its EVENT_EVICT */
+    };
+
+/*
+ * one event of a cache, the evictions and fill of a miss come before its EVENT_MISS
+ */
+    struct CacheEvent {
+        int kind; /* EVENT_ */
+        int set;
+        uint64_t block; /* block address */
+    };
+
+/*
+ * receives the events of the caches it's attached to, in batches,
+ * a cache without observers doesn't record anything
+ */
+    class CacheObserver {
+    public:
+        virtual void observe(const Cache& cache, const CacheEvent *events, size_t count) = 0;
+        virtual ~CacheObserver() = default;
+    };
+
+/*
+ * an observer that collects statistics, exported next to the summary
+ */
+    class Collector : public CacheObserver {
+    public:
+        virtual const char *name() const = 0;
+        virtual void csv(std::ostream& out) const = 0;
+
+        /* a JSON value, no trailing newline */
+        virtual void json(std::ostream& out) const = 0;
+
+    /*
+     * collector by name -- heatmap | regions | ages,
+     * throws InvalidConfig otherwise
+     */
+        static Collector *create(const std::string& name);
+    };
+
+}
+
+#endif //CACHE_SIM_OBSERVER_HPP
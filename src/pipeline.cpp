@@ -0,0 +1,124 @@
+/*
+ * Pipelined trace source definition
+ */
+
+#include "pipeline.hpp"
+#include <algorithm>
+
+namespace cs {
+
+    /*
+     * waits for the other side of a ring, spinning briefly before giving up the core
+     */
+    static void backoff(unsigned& spins) {
+        if (++spins < 64)
+            return;
+        std::this_thread::yield();
+    }
+
+    PipelinedSource::PipelinedSource(TraceSource *source)
+            : _source(source), _pool(DEPTH), _full(DEPTH + 1), _free(DEPTH), _current(nullptr),
+              _done(false), _stop(false), _waiting(false) {
+        for (auto& batch : _pool) {
+            batch.refs.resize(BATCH);
+            batch.size = 0;
+            (void) _free.push(&batch);
+        }
+        _reader = std::thread(&PipelinedSource::read, this);
+    }
+
+    PipelinedSource::~PipelinedSource() {
+        _stop.store(true, std::memory_order_relaxed);
+        _reader.join();
+        delete _source;
+    }
+
+    bool PipelinedSource::push(Batch *batch) {
+        if (!_full.push(batch))
+            return false;
+        /* pairs with the fence in next_batch(), either the simulator sees the batch or this sees it waiting */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ready.notify_one();
+        }
+        return true;
+    }
+
+    void PipelinedSource::read() {
+        try {
+            const Reference *in = nullptr;
+            size_t left = 0;
+            bool end = false;
+            while (!end) {
+                Batch *batch;
+                for (unsigned spins = 0; !_free.pop(batch); backoff(spins)) {
+                    if (_stop.load(std::memory_order_relaxed))
+                        return;
+                }
+
+                /* fill the batch from as many of the source's runs as it takes */
+                batch->size = 0;
+                while (batch->size < BATCH) {
+                    if (left == 0 && (left = _source->next_batch(in)) == 0) {
+                        end = true;
+                        break;
+                    }
+                    size_t n = std::min(left, BATCH - batch->size);
+                    std::copy(in, in + n, batch->refs.begin() + batch->size);
+                    batch->size += n;
+                    in += n;
+                    left -= n;
+                }
+
+                if (batch->size == 0) {
+                    (void) _free.push(batch);
+                    break;
+                }
+                for (unsigned spins = 0; !push(batch); backoff(spins)) {
+                    if (_stop.load(std::memory_order_relaxed))
+                        return;
+                }
+            }
+        } catch (...) {
+            _error = std::current_exception();
+        }
+
+        /* end of the trace, or of what could be read of it */
+        for (unsigned spins = 0; !push(nullptr); backoff(spins)) {
+            if (_stop.load(std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    size_t PipelinedSource::next_batch(const Reference *&batch) {
+        if (_current != nullptr) {
+            (void) _free.push(_current);
+            _current = nullptr;
+        }
+        if (_done)
+            return 0;
+
+        Batch *next;
+        bool popped = false;
+        for (unsigned spins = 0; spins < 128 && !(popped = _full.pop(next)); backoff(spins))
+            ;
+        if (!popped) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!_full.pop(next))
+                _ready.wait(lock);
+            _waiting.store(false, std::memory_order_relaxed);
+        }
+        if (next == nullptr) {
+            _done = true;
+            if (_error)
+                std::rethrow_exception(_error);
+            return 0;
+        }
+        _current = next;
+        batch = next->refs.data();
+        return next->size;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Pipelined trace source,
+ * reads and decodes a trace on its own thread while the simulator runs
+ */
+
+#ifndef CACHE_SIM_PIPELINE_HPP
+#define CACHE_SIM_PIPELINE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "reference.hpp"
+#include "spsc_ring.hpp"
+#include "trace_source.hpp"
+
+namespace cs {
+
+/*
+ * wraps another trace source, whose batches a reader thread copies into
+ * fixed-size batches handed over a lock-free ring, the batches are recycled
+ * through a second ring once the simulator is done with them
+ * a simulator that outruns the reader spins briefly, then sleeps until the next batch is pushed
+ */
+    class PipelinedSource : public TraceSource {
+    public:
+        static const size_t BATCH = 16384; /* references per batch */
+        static const size_t DEPTH = 8; /* batches in flight */
+
+    private:
+        struct Batch {
+            std::vector<Reference> refs;
+            size_t size;
+        };
+
+        TraceSource *_source;
+        std::vector<Batch> _pool;
+        SpscRing<Batch *> _full, _free;
+        Batch *_current; /* batch the simulator holds, recycled on the next call */
+        bool _done;
+        std::atomic<bool> _stop;
+        std::atomic<bool> _waiting; /* the simulator sleeps on _ready for a full batch */
+        std::mutex _mutex;
+        std::condition_variable _ready;
+        std::exception_ptr _error; /* set by the reader before it pushes the last batch */
+        std::thread _reader;
+
+        void read();
+
+        /* pushes a full batch, or the nullptr ending them, waking the simulator if it sleeps */
+        bool push(Batch *batch);
+
+    public:
+    /*
+     * takes ownership of source and starts reading it
+     */
+        explicit PipelinedSource(TraceSource *source);
+        ~PipelinedSource() override;
+
+        PipelinedSource(const PipelinedSource&) = delete;
+        PipelinedSource& operator=(const PipelinedSource&) = delete;
+
+    /*
+     * rethrows whatever the reader thread threw, once the batches before it are consumed
+     */
+        size_t next_batch(const Reference *&batch) override;
+    };
+
+}
+
+#endif //CACHE_SIM_PIPELINE_HPP
@@ -0,0 +1,34 @@
+/*
+ * decoded memory reference,
+ * what trace readers produce and what the cache driver consumes
+ */
+
+#ifndef CACHE_SIM_REFERENCE_HPP
+#define CACHE_SIM_REFERENCE_HPP
+
+#include <cstdint>
+
+namespace cs {
+
+    enum {
+        DATA_READ,
+        DATA_WRITE,
+        INSTRUCTION_READ,
+        WRITEBACK /* a dirty block written back by the level above, never in a trace */
+    };
+
+    /* references that write the cache they reach */
+    inline bool is_write(int type) { return type == DATA_WRITE || type == WRITEBACK; }
+
+/*
+ * one memory reference: DATA_READ, DATA_WRITE or INSTRUCTION_READ and its address
+ */
+    struct Reference {
+        uint64_t address;
+        int32_t type;
+        uint32_t reserved;
+    };
+
+}
+
+#endif //CACHE_SIM_REFERENCE_HPP
@@ -0,0 +1,185 @@
+/*
+ * Replacement policies definition
+ */
+
+#include "replacement.hpp"
+
+namespace cs {
+
+    ReplacementPolicy *ReplacementPolicy::create(const std::string& name, int num_sets, int ways) {
+        if (name == "lru")
+            return new LruPolicy(num_sets, ways);
+        if (name == "plru")
+            return new PlruPolicy(num_sets, ways);
+        if (name == "srrip")
+            return new SrripPolicy(num_sets, ways);
+        if (name == "random")
+            return new RandomPolicy(num_sets, ways);
+        if (name == "fifo")
+            return new FifoPolicy(num_sets, ways);
+        if (name == "lfu")
+            return new LfuPolicy(num_sets, ways);
+        throw CSException("unknown replacement policy -- lru | plru | srrip | random | fifo | lfu");
+    }
+
+    LruPolicy::LruPolicy(int num_sets, int ways) : ReplacementPolicy(0, ways) {
+        resize(num_sets);
+    }
+
+    void LruPolicy::resize(int num_sets) {
+        _prev.resize(static_cast<size_t>(num_sets) * _ways);
+        _next.resize(static_cast<size_t>(num_sets) * _ways);
+        _head.resize(num_sets, 0);
+        _tail.resize(num_sets, _ways - 1);
+
+        /* every new set starts out as the list 0 .. ways-1 */
+        for (int set = _num_sets; set < num_sets; set++) {
+            size_t base = static_cast<size_t>(set) * _ways;
+            for (int way = 0; way < _ways; way++) {
+                _prev[base + way] = way - 1;
+                _next[base + way] = way + 1 < _ways ? way + 1 : -1;
+            }
+        }
+        _num_sets = num_sets;
+    }
+
+    void LruPolicy::touch(int set, int way) {
+        if (_head[set] == way)
+            return;
+        size_t base = static_cast<size_t>(set) * _ways;
+
+        /* unlink */
+        int32_t prev = _prev[base + way], next = _next[base + way];
+        _next[base + prev] = next;
+        if (next >= 0)
+            _prev[base + next] = prev;
+        else
+            _tail[set] = prev;
+
+        /* push to the MRU end */
+        _prev[base + way] = -1;
+        _next[base + way] = _head[set];
+        _prev[base + _head[set]] = way;
+        _head[set] = way;
+    }
+
+    std::vector<StateSpan> LruPolicy::state() {
+        return {span(_prev), span(_next), span(_head), span(_tail)};
+    }
+
+    PlruPolicy::PlruPolicy(int num_sets, int ways) : ReplacementPolicy(num_sets, ways), _levels(0) {
+        if (ways <= 0 || (ways & (ways - 1)) != 0)
+            throw CSException("plru replacement needs a power of two associativity");
+        while ((1 << _levels) < ways)
+            _levels++;
+        _bits.assign(static_cast<size_t>(num_sets) * (ways - 1), 0);
+    }
+
+    void PlruPolicy::touch(int set, int way) {
+        uint8_t *bits = _bits.data() + static_cast<size_t>(set) * (_ways - 1);
+        int node = 0;
+        for (int level = _levels - 1; level >= 0; level--) {
+            int dir = (way >> level) & 1;
+            bits[node] = static_cast<uint8_t>(dir ^ 1); /* point away from the referenced way */
+            node = 2 * node + 1 + dir;
+        }
+    }
+
+    int PlruPolicy::victim(int set, const LineMeta *meta) {
+        const uint8_t *bits = _bits.data() + static_cast<size_t>(set) * (_ways - 1);
+        int node = 0, way = 0;
+        for (int level = 0; level < _levels; level++) {
+            int dir = bits[node];
+            way = (way << 1) | dir;
+            node = 2 * node + 1 + dir;
+        }
+        return way;
+    }
+
+    const uint8_t SrripPolicy::RRPV_MAX;
+
+    SrripPolicy::SrripPolicy(int num_sets, int ways)
+            : ReplacementPolicy(0, ways), _words((static_cast<size_t>(ways) + 63) / 64) {
+        resize(num_sets);
+    }
+
+    void SrripPolicy::resize(int num_sets) {
+        _masks.resize(static_cast<size_t>(num_sets) * RRPVS * _words, 0);
+        /* every way of a new set at RRPV_MAX */
+        for (int set = _num_sets; set < num_sets; set++) {
+            uint64_t *distant = masks(set) + RRPV_MAX * _words;
+            for (size_t w = 0; w < _words; w++) {
+                int left = _ways - static_cast<int>(w) * 64;
+                distant[w] = left >= 64 ? ~uint64_t(0) : (uint64_t(1) << left) - 1;
+            }
+        }
+        _num_sets = num_sets;
+    }
+
+    int SrripPolicy::victim(int set, const LineMeta *meta) {
+        uint64_t *m = masks(set);
+
+        /* the highest RRPV any way has */
+        int rrpv = RRPV_MAX;
+        for (; rrpv > 0; rrpv--) {
+            size_t w = 0;
+            while (w < _words && m[rrpv * _words + w] == 0)
+                w++;
+            if (w < _words)
+                break;
+        }
+
+        /* age the set in one step, as if it was incremented until a line reached RRPV_MAX */
+        int age = RRPV_MAX - rrpv;
+        if (age != 0) {
+            for (int v = RRPV_MAX; v >= 0; v--) {
+                for (size_t w = 0; w < _words; w++)
+                    m[v * _words + w] = v >= age ? m[(v - age) * _words + w] : 0;
+            }
+        }
+
+        /* the first way at RRPV_MAX, as the lowest way wins ties */
+        const uint64_t *distant = m + RRPV_MAX * _words;
+        size_t w = 0;
+        while (distant[w] == 0)
+            w++;
+        return static_cast<int>(w * 64) + __builtin_ctzll(distant[w]);
+    }
+
+    RandomPolicy::RandomPolicy(int num_sets, int ways) : ReplacementPolicy(0, ways) {
+        resize(num_sets);
+    }
+
+    void RandomPolicy::resize(int num_sets) {
+        _state.resize(num_sets);
+        for (int set = _num_sets; set < num_sets; set++)
+            _state[set] = seed(set);
+        _num_sets = num_sets;
+    }
+
+    int RandomPolicy::victim(int set, const LineMeta *meta) {
+        uint64_t& state = _state[set];
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<int>(state % static_cast<uint64_t>(_ways));
+    }
+
+    int FifoPolicy::victim(int set, const LineMeta *meta) {
+        int victim = _next[set];
+        _next[set] = victim + 1 < _ways ? victim + 1 : 0;
+        return victim;
+    }
+
+    int LfuPolicy::victim(int set, const LineMeta *meta) {
+        uint32_t min_freq = meta[0].count;
+        int victim = 0;
+        for (int way = 1; way < _ways; way++) {
+            if (meta[way].count < min_freq) {
+                min_freq = meta[way].count;
+                victim = way;
+            }
+        }
+        return victim;
+    }
+}
@@ -0,0 +1,210 @@
+/*
+ * Replacement policies,
+ * decide which line of a full set gets evicted
+ */
+
+#ifndef CACHE_SIM_REPLACEMENT_HPP
+#define CACHE_SIM_REPLACEMENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+
+namespace cs {
+
+/*
+ * per-line metadata, kept by the cache in its own array next to the tag array
+ */
+    struct LineMeta {
+        uint32_t count; /* number of times the line was referenced */
+        uint32_t flags; /* LINE_ bits */
+    };
+
+    enum {
+        LINE_DIRTY = 1 /* written since it was filled, the next level needs it back on eviction */
+    };
+
+/*
+ * a raw array of state, saved and restored byte for byte by checkpoints
+ */
+    struct StateSpan {
+        void *data;
+        size_t bytes;
+    };
+
+/*
+ * abstract replacement policy
+ *
+ * the cache tells the policy about hits and fills and asks it for a victim when a set is full,
+ * every policy keeps its own state for all sets, indexed set * ways + way like the tag store
+ */
+    class ReplacementPolicy {
+    protected:
+        int _num_sets;
+        int _ways;
+
+        template <typename T>
+        static StateSpan span(std::vector<T>& v) { return StateSpan{v.data(), v.size() * sizeof(T)}; }
+    public:
+        ReplacementPolicy(int num_sets, int ways) : _num_sets(num_sets), _ways(ways) {}
+        virtual ~ReplacementPolicy() = default;
+
+        /* line `way' of `set' was referenced */
+        virtual void touch(int set, int way) = 0;
+
+        /* a new block was brought into line `way' of `set' */
+        virtual void fill(int set, int way) = 0;
+
+        /* way to evict from the full set `set', meta points at the set's metadata */
+        virtual int victim(int set, const LineMeta *meta) = 0;
+
+        virtual const char *name() const = 0;
+
+        /* every array the policy keeps its state in, see Checkpoint */
+        virtual std::vector<StateSpan> state() = 0;
+
+        /* grows the policy to num_sets sets, the new ones as a fresh policy's, for sparse tag stores */
+        virtual void resize(int num_sets) = 0;
+
+        /*
+         * a sparse tag store put set `set' in slot `slot', which the policy indexes it by from now on,
+         * for policies whose fresh state depends on the set
+         */
+        virtual void place(int slot, int set) {}
+
+    /*
+     * creates a policy by name: lru | plru | srrip | random | fifo | lfu
+     * throws CSException on unknown names or unsupported geometry
+     */
+        static ReplacementPolicy *create(const std::string& name, int num_sets, int ways);
+    };
+
+/*
+ * least recently used, a doubly linked recency list per set
+ * touch and victim are O(1)
+ */
+    class LruPolicy : public ReplacementPolicy {
+        std::vector<int32_t> _prev, _next; /* per line, towards the MRU / LRU end */
+        std::vector<int32_t> _head, _tail; /* per set, MRU and LRU way */
+    public:
+        LruPolicy(int num_sets, int ways);
+        void touch(int set, int way) override;
+        void fill(int set, int way) override { touch(set, way); }
+        int victim(int set, const LineMeta *meta) override { return _tail[set]; }
+        const char *name() const override { return "lru"; }
+        std::vector<StateSpan> state() override;
+        void resize(int num_sets) override;
+    };
+
+/*
+ * tree pseudo-LRU, ways - 1 direction bits per set
+ * touch and victim walk log2(ways) bits, ways must be a power of two
+ */
+    class PlruPolicy : public ReplacementPolicy {
+        std::vector<uint8_t> _bits; /* (ways - 1) per set, heap ordered, 1 = victim is in the right half */
+        int _levels;
+    public:
+        PlruPolicy(int num_sets, int ways);
+        void touch(int set, int way) override;
+        void fill(int set, int way) override { touch(set, way); }
+        int victim(int set, const LineMeta *meta) override;
+        const char *name() const override { return "plru"; }
+        std::vector<StateSpan> state() override { return {span(_bits)}; }
+        void resize(int num_sets) override {
+            _num_sets = num_sets;
+            _bits.resize(static_cast<size_t>(num_sets) * (_ways - 1), 0);
+        }
+    };
+
+/*
+ * static re-reference interval prediction with 2-bit RRPVs,
+ * hits predict near re-reference, fills predict long re-reference
+ *
+ * a set keeps a bitmask of its ways for each RRPV rather than each way's RRPV,
+ * so the victim is the first way of the highest non-empty mask and aging shifts masks, not ways,
+ * one 64-bit word per mask up to 64 ways
+ */
+    class SrripPolicy : public ReplacementPolicy {
+        static const int RRPVS = 4;
+        size_t _words; /* words per mask */
+        std::vector<uint64_t> _masks; /* by set, by RRPV, _words each */
+
+        uint64_t *masks(int set) { return _masks.data() + static_cast<size_t>(set) * RRPVS * _words; }
+
+        /* moves way to rrpv */
+        void set_rrpv(int set, int way, int rrpv) {
+            uint64_t *m = masks(set) + way / 64;
+            uint64_t bit = uint64_t(1) << (way % 64);
+            for (int v = 0; v < RRPVS; v++)
+                m[v * _words] &= ~bit;
+            m[rrpv * _words] |= bit;
+        }
+    public:
+        static const uint8_t RRPV_MAX = RRPVS - 1;
+        SrripPolicy(int num_sets, int ways);
+        void touch(int set, int way) override { set_rrpv(set, way, 0); }
+        void fill(int set, int way) override { set_rrpv(set, way, RRPV_MAX - 1); }
+        int victim(int set, const LineMeta *meta) override;
+        const char *name() const override { return "srrip"; }
+        std::vector<StateSpan> state() override { return {span(_masks)}; }
+        void resize(int num_sets) override;
+    };
+
+/*
+ * uniformly random victim from fixed-seed xorshift generators, so runs are repeatable,
+ * one generator per set so sets stay independent of each other
+ */
+    class RandomPolicy : public ReplacementPolicy {
+        std::vector<uint64_t> _state;
+
+        static uint64_t seed(int set) { return 0x9e3779b97f4a7c15ull * (static_cast<uint64_t>(set) + 1); }
+    public:
+        RandomPolicy(int num_sets, int ways);
+        void touch(int set, int way) override {}
+        void fill(int set, int way) override {}
+        int victim(int set, const LineMeta *meta) override;
+        const char *name() const override { return "random"; }
+        std::vector<StateSpan> state() override { return {span(_state)}; }
+        void resize(int num_sets) override;
+        void place(int slot, int set) override { _state[slot] = seed(set); }
+    };
+
+/*
+ * first in first out, a round-robin pointer per set
+ */
+    class FifoPolicy : public ReplacementPolicy {
+        std::vector<int32_t> _next;
+    public:
+        FifoPolicy(int num_sets, int ways) : ReplacementPolicy(num_sets, ways), _next(num_sets, 0) {}
+        void touch(int set, int way) override {}
+        void fill(int set, int way) override {}
+        int victim(int set, const LineMeta *meta) override;
+        const char *name() const override { return "fifo"; }
+        std::vector<StateSpan> state() override { return {span(_next)}; }
+        void resize(int num_sets) override {
+            _num_sets = num_sets;
+            _next.resize(num_sets, 0);
+        }
+    };
+
+/*
+ * least frequently used, the line with the lowest reference count (lowest way on ties)
+ * this is the simulator's original policy, kept so old results can be reproduced
+ */
+    class LfuPolicy : public ReplacementPolicy {
+    public:
+        LfuPolicy(int num_sets, int ways) : ReplacementPolicy(num_sets, ways) {}
+        void touch(int set, int way) override {}
+        void fill(int set, int way) override {}
+        int victim(int set, const LineMeta *meta) override;
+        const char *name() const override { return "lfu"; }
+        std::vector<StateSpan> state() override { return {}; }
+        void resize(int num_sets) override { _num_sets = num_sets; }
+    };
+
+}
+
+#endif //CACHE_SIM_REPLACEMENT_HPP
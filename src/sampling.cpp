@@ -0,0 +1,213 @@
+/*
+ * Sampled simulation definition
+ */
+
+#include "sampling.hpp"
+#include <cmath>
+#include "errors.hpp"
+
+namespace cs {
+
+    /*
+     * a positive count, with a K, M or G suffix
+     */
+    static uint64_t count_of(const std::string& value, const std::string& spec) {
+        size_t used = 0;
+        unsigned long long n = 0;
+        try {
+            if (!value.empty() && value[0] != '-')
+                n = std::stoull(value, &used, 10);
+        } catch (std::exception&) {
+            used = 0;
+        }
+        if (used != 0 && used + 1 == value.size()) {
+            switch (value[used]) {
+                case 'k': case 'K': n <<= 10; used++; break;
+                case 'm': case 'M': n <<= 20; used++; break;
+                case 'g': case 'G': n <<= 30; used++; break;
+                default: break;
+            }
+        }
+        if (used == 0 || used != value.size() || n == 0)
+            throw InvalidConfig("invalid sampling plan -- " + spec + ", bad count " + value);
+        return n;
+    }
+
+    /*
+     * t quantile for a two-sided 95% interval, exact to 30 degrees of freedom
+     * and the Cornish-Fisher approximation past them
+     */
+    static double t_95(double df) {
+        static const double T[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        if (df <= 30)
+            return T[static_cast<int>(df) - 1];
+        return 1.960 + 2.372 / df;
+    }
+
+    SamplingPlan SamplingPlan::parse(const std::string& spec) {
+        std::vector<std::string> fields;
+        size_t begin = 0, end;
+        while ((end = spec.find(':', begin)) != std::string::npos) {
+            fields.push_back(spec.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        fields.push_back(spec.substr(begin));
+        if (fields.size() < 2 || fields.size() > 3)
+            throw InvalidConfig("invalid sampling plan -- " + spec + ", expected unit:period[:warm]");
+
+        SamplingPlan plan;
+        plan.unit = count_of(fields[0], spec);
+        plan.period = count_of(fields[1], spec);
+        if (plan.unit > plan.period)
+            throw InvalidConfig("invalid sampling plan -- " + spec + ", unit is longer than the period");
+        plan.warm = fields.size() == 3 ? (fields[2] == "0" ? 0 : count_of(fields[2], spec)) : plan.period - plan.unit;
+        if (plan.warm > plan.period - plan.unit)
+            throw InvalidConfig("invalid sampling plan -- " + spec + ", unit and warm are longer than the period");
+        return plan;
+    }
+
+    void RatioEstimator::add(double x, double y) {
+        _n += 1;
+        _x += x;
+        _y += y;
+        _xx += x * x;
+        _yy += y * y;
+        _xy += x * y;
+    }
+
+    Estimate RatioEstimator::estimate() const {
+        if (_y == 0)
+            return Estimate{0, _n > 1 ? 0.0 : -1.0};
+        double r = _x / _y;
+        if (_n < 2)
+            return Estimate{r, -1};
+        double residuals = _xx - 2 * r * _xy + r * r * _yy;
+        double variance = residuals > 0 ? residuals / (_n - 1) : 0;
+        double mean_y = _y / _n;
+        return Estimate{r, t_95(_n - 1) * std::sqrt(variance / _n) / mean_y};
+    }
+
+    SampledRun::SampledRun(CacheDriver& driver, const SamplingPlan& plan)
+            : _driver(driver), _plan(plan), _caches(driver.caches()),
+              _totals(_caches.size(), CacheStats{0, 0, 0, 0, 0, 0}),
+              _miss_rates(_caches.size()), _miss_counts(_caches.size()),
+              _units(0), _references(0), _batch(nullptr), _left(0) {
+        /*
+         * misses are not classified, a block's first miss in a unit may have been touched
+         * in the references skipped before it, and the totals would not project to the trace
+         */
+        for (auto cache : _caches)
+            cache->classify(false);
+    }
+
+    uint64_t SampledRun::advance(TraceSource& trace, uint64_t count, phase p) {
+        uint64_t done = 0;
+        while (done < count) {
+            if (_left == 0) {
+                /* skipped references past the current batch need not be read at all */
+                if (p == SKIP) {
+                    uint64_t seeked = trace.seek(count - done);
+                    done += seeked;
+                    if (done == count)
+                        break;
+                }
+                if ((_left = trace.next_batch(_batch)) == 0)
+                    break;
+            }
+            size_t n = count - done < _left ? static_cast<size_t>(count - done) : _left;
+            if (p == WARM)
+                _driver.warm(_batch, n);
+            else if (p == MEASURE)
+                (void) _driver.exec(_batch, n);
+            _batch += n;
+            _left -= n;
+            done += n;
+        }
+        _references += done;
+        return done;
+    }
+
+    void SampledRun::measured() {
+        for (size_t c = 0; c < _caches.size(); c++) {
+            const CacheStats& stats = _caches[c]->stats();
+            double accesses = static_cast<double>(stats.hits) + static_cast<double>(stats.misses);
+            _miss_rates[c].add(stats.misses, accesses);
+            _miss_counts[c].add(stats.misses, static_cast<double>(_plan.unit));
+            _totals[c].hits += stats.hits;
+            _totals[c].misses += stats.misses;
+            _totals[c].writebacks += stats.writebacks;
+        }
+        _amat.add(_driver.AMAT(), 1);
+        _units++;
+    }
+
+    void SampledRun::run(TraceSource& trace) {
+        uint64_t skip = _plan.period - _plan.unit - _plan.warm;
+        while (true) {
+            if (advance(trace, skip, SKIP) < skip || advance(trace, _plan.warm, WARM) < _plan.warm)
+                break;
+            /* each unit counts its own references only */
+            for (auto cache : _caches)
+                cache->clear_stats();
+            if (advance(trace, _plan.unit, MEASURE) < _plan.unit)
+                break; /* a unit cut short by the end of the trace isn't measured */
+            measured();
+        }
+
+        for (size_t c = 0; c < _caches.size(); c++) {
+            _caches[c]->clear_stats();
+            _caches[c]->add_stats(_totals[c]);
+        }
+    }
+
+    static void print(std::ostream& out, const Estimate& estimate) {
+        out << estimate.value;
+        if (estimate.error >= 0)
+            out << " +- " << estimate.error;
+    }
+
+    /* an estimated count, rounded */
+    static void print_count(std::ostream& out, const Estimate& estimate) {
+        out << std::llround(estimate.value);
+        if (estimate.error >= 0)
+            out << " +- " << std::llround(estimate.error);
+    }
+
+    void SampledRun::summary(std::ostream& out) const {
+        double sampled = static_cast<double>(_units) * static_cast<double>(_plan.unit);
+        out << "Sampled estimates: " << _units << " units of " << _plan.unit << " references every "
+            << _plan.period << ", " << _plan.warm << " warmed before each\n";
+        out << "  sampled " << static_cast<uint64_t>(sampled) << " of " << _references << " references ("
+            << (_references == 0 ? 0 : 100 * sampled / static_cast<double>(_references)) << "%)\n";
+        if (_units == 0) {
+            out << "  the trace ended before a whole unit, nothing to estimate\n";
+            return;
+        }
+        if (_units < 2)
+            out << "  too few units to bound the error\n";
+        else
+            out << "  errors are half-widths of 95% confidence intervals\n";
+        out << "\n";
+
+        for (size_t c = 0; c < _caches.size(); c++) {
+            Estimate miss_rate = _miss_rates[c].estimate();
+            Estimate misses = _miss_counts[c].estimate();
+            misses.value *= static_cast<double>(_references);
+            if (misses.error > 0)
+                misses.error *= static_cast<double>(_references);
+            out << _caches[c]->name() << " (" << _caches[c]->type() << "):\n";
+            out << "  miss rate: ";
+            print(out, miss_rate);
+            out << "\n  hit rate: ";
+            print(out, Estimate{1 - miss_rate.value, miss_rate.error});
+            out << "\n  projected misses: ";
+            print_count(out, misses);
+            out << "\n\n";
+        }
+        out << "average memory access time: ";
+        print(out, _amat.estimate());
+        out << "\n";
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * Sampled simulation,
+ * systematic samples of a trace in the manner of SMARTS, measured in full and extrapolated
+ * with confidence intervals, the references between them warmed or skipped
+ */
+
+#ifndef CACHE_SIM_SAMPLING_HPP
+#define CACHE_SIM_SAMPLING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+#include "reference.hpp"
+#include "trace_source.hpp"
+
+namespace cs {
+
+/*
+ * every `period' references the last `unit' are measured and the `warm' before them
+ * functionally warm the caches -- tags, dirty bits and replacement state are updated,
+ * nothing is counted -- while the rest are skipped without being simulated at all,
+ * seeked past when the trace can seek
+ *
+ * named by a spec `unit:period[:warm]', e.g. `10K:1M:200K', counts take a K, M or G suffix,
+ * warm defaults to everything between the units
+ */
+    struct SamplingPlan {
+        uint64_t unit, period, warm;
+
+        /* throws InvalidConfig on a malformed spec or unit + warm > period */
+        static SamplingPlan parse(const std::string& spec);
+    };
+
+/*
+ * an estimate and the half-width of its 95% confidence interval,
+ * error is negative when there were too few units to bound it
+ */
+    struct Estimate {
+        double value, error;
+    };
+
+/*
+ * ratio estimator of sum(x) / sum(y) over the units, e.g. misses over accesses,
+ * its error from the spread of x_i - r * y_i
+ */
+    class RatioEstimator {
+        double _n, _x, _y, _xx, _yy, _xy;
+    public:
+        RatioEstimator() : _n(0), _x(0), _y(0), _xx(0), _yy(0), _xy(0) {}
+
+        void add(double x, double y);
+        Estimate estimate() const;
+    };
+
+/*
+ * runs a trace through a driver following a SamplingPlan
+ *
+ * every measured unit starts from zeroed counters, after the run the caches hold the counters
+ * of the measured units only, so CacheDriver::summary shows what was sampled
+ * warming runs through CacheDriver::warm, so only measured units are counted or observed,
+ * misses are not classified at all, the caches' classification is turned off
+ * the driver must not be traced, warming would show up in the trace
+ */
+    class SampledRun {
+        CacheDriver& _driver;
+        SamplingPlan _plan;
+        std::vector<Cache *> _caches;
+        std::vector<CacheStats> _totals; /* counters summed over the measured units */
+        std::vector<RatioEstimator> _miss_rates; /* per cache, misses over accesses */
+        std::vector<RatioEstimator> _miss_counts; /* per cache, misses over references */
+        RatioEstimator _amat; /* per-unit AMAT over units */
+        uint64_t _units, _references;
+
+        /* what's left of the trace's current batch */
+        const Reference *_batch;
+        size_t _left;
+
+        enum phase {
+            SKIP,
+            WARM,
+            MEASURE
+        };
+
+        /*
+         * takes up to count references from the trace in the given phase,
+         * returns how many there were
+         */
+        uint64_t advance(TraceSource& trace, uint64_t count, phase p);
+
+        /* counters of the unit just measured, into the estimators */
+        void measured();
+
+    public:
+        SampledRun(CacheDriver& driver, const SamplingPlan& plan);
+
+        /* the whole trace */
+        void run(TraceSource& trace);
+
+        /* units measured and references in the trace */
+        uint64_t units() const { return _units; }
+        uint64_t references() const { return _references; }
+
+        /* estimates of every cache's miss rate and of the AMAT, projected over the whole trace */
+        void summary(std::ostream& out) const;
+    };
+
+}
+
+#endif //CACHE_SIM_SAMPLING_HPP
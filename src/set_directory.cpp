@@ -0,0 +1,41 @@
+/*
+ * Set directory definition
+ */
+
+#include "set_directory.hpp"
+
+namespace cs {
+
+    SetDirectory::SetDirectory() : _table(16, Entry{EMPTY, EMPTY}), _shift(60) {}
+
+    int SetDirectory::slot(int set) {
+        size_t mask = _table.size() - 1;
+        size_t i = index(set);
+        for (; _table[i].set != EMPTY; i = (i + 1) & mask) {
+            if (_table[i].set == set)
+                return _table[i].slot;
+        }
+
+        int slot = static_cast<int>(_sets.size());
+        _table[i] = Entry{set, slot};
+        _sets.push_back(set);
+        if (_sets.size() * 2 > _table.size())
+            grow();
+        return slot;
+    }
+
+    void SetDirectory::grow() {
+        std::vector<Entry> old(_table.size() * 2, Entry{EMPTY, EMPTY});
+        old.swap(_table);
+        _shift--;
+        size_t mask = _table.size() - 1;
+        for (const Entry& entry : old) {
+            if (entry.set == EMPTY)
+                continue;
+            size_t i = index(entry.set);
+            while (_table[i].set != EMPTY)
+                i = (i + 1) & mask;
+            _table[i] = entry;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Set directory,
+ * the sets of a sparse tag store, materialized as they're first touched
+ */
+
+#ifndef CACHE_SIM_SET_DIRECTORY_HPP
+#define CACHE_SIM_SET_DIRECTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cs {
+
+/*
+ * hands out slots 0, 1, 2 ... to sets in the order they're first touched,
+ * so a cache keeps tags and replacement state only for the sets its working set maps to
+ * open addressing on the set index, linear probing, at most half full
+ */
+    class SetDirectory {
+        static const int32_t EMPTY = -1;
+
+        struct Entry {
+            int32_t set;
+            int32_t slot;
+        };
+
+        std::vector<Entry> _table;
+        unsigned _shift;
+        std::vector<int32_t> _sets; /* by slot, its set */
+
+        size_t index(int set) const {
+            return static_cast<size_t>((static_cast<uint64_t>(set) * 0x9e3779b97f4a7c15ull) >> _shift);
+        }
+
+        /* doubles the table */
+        void grow();
+
+    public:
+        SetDirectory();
+
+        /* slot of set, -1 if it was never touched */
+        int find(int set) const {
+            size_t mask = _table.size() - 1;
+            for (size_t i = index(set); _table[i].set != EMPTY; i = (i + 1) & mask) {
+                if (_table[i].set == set)
+                    return _table[i].slot;
+            }
+            return -1;
+        }
+
+        /* slot of set, the next one, size() - 1, if it's touched for the first time */
+        int slot(int set);
+
+        int size() const { return static_cast<int>(_sets.size()); }
+        int set_of(int slot) const { return _sets[slot]; }
+    };
+
+}
+
+#endif //CACHE_SIM_SET_DIRECTORY_HPP
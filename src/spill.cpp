@@ -0,0 +1,80 @@
+/*
+ * Spill buffers definition
+ */
+
+#include "spill.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace cs {
+
+    SpillBuffer::SpillBuffer(size_t budget) : _budget(budget), _capacity(0), _data(nullptr), _fd(-1) {}
+
+    SpillBuffer::~SpillBuffer() {
+        if (_fd < 0) {
+            std::free(_data);
+            return;
+        }
+        if (_data != nullptr)
+            munmap(_data, _capacity);
+        ::close(_fd);
+    }
+
+    void SpillBuffer::map(size_t capacity) {
+        if (ftruncate(_fd, static_cast<off_t>(capacity)) != 0)
+            throw CSException("can't grow the spill file");
+        void *map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (map == MAP_FAILED)
+            throw CSException("can't map the spill file");
+        _data = static_cast<char *>(map);
+        _capacity = capacity;
+    }
+
+    void SpillBuffer::reserve(size_t bytes) {
+        if (bytes <= _capacity)
+            return;
+
+        if (_fd < 0 && bytes <= _budget) {
+            void *grown = std::realloc(_data, bytes);
+            if (grown == nullptr)
+                throw CSException("out of memory");
+            _data = static_cast<char *>(grown);
+            _capacity = bytes;
+            return;
+        }
+
+        if (_fd >= 0) {
+            /* a fresh mapping of the grown file, the old one's pages are the file's already */
+            munmap(_data, _capacity);
+            _data = nullptr;
+            _capacity = 0;
+            map(bytes);
+            return;
+        }
+
+        /* moving from the heap to a file */
+        const char *dir = std::getenv("TMPDIR");
+        std::string path = std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp") + "/cache-sim-spill-XXXXXX";
+        _fd = mkstemp(&path[0]);
+        if (_fd < 0)
+            throw CSException("can't create a spill file");
+        unlink(path.c_str());
+        char *heap = _data;
+        size_t used = _capacity;
+        try {
+            map(bytes);
+        } catch (...) {
+            _data = heap;
+            _capacity = used;
+            ::close(_fd);
+            _fd = -1;
+            throw;
+        }
+        if (used != 0)
+            memcpy(_data, heap, used);
+        std::free(heap);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Spill buffers,
+ * growable arrays kept in memory up to a budget and in a mapped temporary file past it
+ */
+
+#ifndef CACHE_SIM_SPILL_HPP
+#define CACHE_SIM_SPILL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "errors.hpp"
+
+namespace cs {
+
+/*
+ * bytes on the heap while they fit the budget, past it moved to an unlinked file under
+ * $TMPDIR (or /tmp) mapped shared, so the page cache rather than the process holds them
+ * the file is gone as soon as the buffer is
+ */
+    class SpillBuffer {
+        size_t _budget; /* bytes kept on the heap at most */
+        size_t _capacity;
+        char *_data;
+        int _fd; /* the spill file, -1 while on the heap */
+
+        void map(size_t capacity);
+    public:
+        explicit SpillBuffer(size_t budget);
+        ~SpillBuffer();
+
+        SpillBuffer(const SpillBuffer&) = delete;
+        SpillBuffer& operator=(const SpillBuffer&) = delete;
+
+    /*
+     * makes room for at least bytes, keeping what's there, spilling once past the budget
+     * throws CSException when the spill file can't be made or grown
+     */
+        void reserve(size_t bytes);
+
+        char *data() { return _data; }
+        size_t capacity() const { return _capacity; }
+        bool spilled() const { return _fd >= 0; }
+    };
+
+/*
+ * a SpillBuffer of trivially copyable T, grown by push_back or sized up front
+ */
+    template <typename T>
+    class SpillArray {
+        SpillBuffer _buffer;
+        size_t _size;
+        T *_items;
+    public:
+        explicit SpillArray(size_t budget) : _buffer(budget), _size(0), _items(nullptr) {}
+
+        void push_back(const T& item) {
+            if ((_size + 1) * sizeof(T) > _buffer.capacity()) {
+                _buffer.reserve(2 * (_size + 1) * sizeof(T));
+                _items = reinterpret_cast<T *>(_buffer.data());
+            }
+            _items[_size++] = item;
+        }
+
+        void resize(size_t size) {
+            _buffer.reserve(size * sizeof(T));
+            _items = reinterpret_cast<T *>(_buffer.data());
+            _size = size;
+        }
+
+        T& operator[](size_t i) { return _items[i]; }
+        const T& operator[](size_t i) const { return _items[i]; }
+        size_t size() const { return _size; }
+        bool spilled() const { return _buffer.spilled(); }
+    };
+
+}
+
+#endif //CACHE_SIM_SPILL_HPP
@@ -0,0 +1,89 @@
+/*
+ * Bounded lock-free ring buffer,
+ * one producer thread and one consumer thread
+ */
+
+#ifndef CACHE_SIM_SPSC_RING_HPP
+#define CACHE_SIM_SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace cs {
+
+    template <typename T>
+    class SpscRing {
+        /*
+         * each index on its own cache line, so the two threads don't share one,
+         * allocated apart since new ignores over-alignment before C++17,
+         * so rings and whatever holds them keep an ordinary alignment
+         */
+        struct Indices {
+            alignas(64) std::atomic<size_t> head; /* next slot to pop, written by the consumer */
+            alignas(64) std::atomic<size_t> tail; /* next slot to push, written by the producer */
+        };
+
+        std::vector<T> _slots;
+        size_t _mask;
+        Indices *_indices;
+
+    public:
+    /*
+     * capacity is rounded up to a power of two
+     */
+        explicit SpscRing(size_t capacity) : _indices(nullptr) {
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+            _slots.resize(size);
+            _mask = size - 1;
+
+            void *indices;
+            if (posix_memalign(&indices, alignof(Indices), sizeof(Indices)) != 0)
+                throw std::bad_alloc();
+            _indices = new (indices) Indices();
+            _indices->head.store(0, std::memory_order_relaxed);
+            _indices->tail.store(0, std::memory_order_relaxed);
+        }
+
+        ~SpscRing() {
+            _indices->~Indices();
+            free(_indices);
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+    /*
+     * producer side, false if the ring is full
+     */
+        bool push(const T& value) {
+            size_t tail = _indices->tail.load(std::memory_order_relaxed);
+            if (tail - _indices->head.load(std::memory_order_acquire) == _slots.size())
+                return false;
+            _slots[tail & _mask] = value;
+            _indices->tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+    /*
+     * consumer side, false if the ring is empty
+     */
+        bool pop(T& value) {
+            size_t head = _indices->head.load(std::memory_order_relaxed);
+            if (head == _indices->tail.load(std::memory_order_acquire))
+                return false;
+            value = _slots[head & _mask];
+            _indices->head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t capacity() const { return _slots.size(); }
+    };
+
+}
+
+#endif //CACHE_SIM_SPSC_RING_HPP
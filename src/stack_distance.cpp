@@ -0,0 +1,118 @@
+/*
+ * LRU stack distance analysis definition
+ */
+
+#include "stack_distance.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace cs {
+
+    StackDistance::StackDistance(size_t block_size, int num_sets, int max_ways, unsigned address_size)
+            : _block_size(block_size), _num_sets(num_sets), _max_ways(max_ways),
+              _sets(num_sets), _histogram(max_ways, 0), _far(0), _cold(0) {
+        if (max_ways <= 0)
+            throw CSException("invalid maximum associativity");
+
+        /* a direct mapped cache with this set count has the same set and tag bits */
+        _at = new AddressTranslator(static_cast<uint64_t>(block_size) * num_sets, address_size,
+                                    block_size, num_sets, 1);
+    }
+
+    StackDistance::~StackDistance() {
+        delete _at;
+    }
+
+    void StackDistance::add(std::vector<uint32_t>& tree, uint32_t pos, int32_t delta) {
+        for (size_t n = tree.size(); pos < n; pos += pos & (~pos + 1))
+            tree[pos] += delta;
+    }
+
+    uint32_t StackDistance::prefix(const std::vector<uint32_t>& tree, uint32_t pos) {
+        uint32_t sum = 0;
+        for (; pos > 0; pos -= pos & (~pos + 1))
+            sum += tree[pos];
+        return sum;
+    }
+
+    void StackDistance::compact(SetState& state) {
+        std::vector<std::pair<uint32_t, uint64_t>> live;
+        live.reserve(state.last.size());
+        for (auto& it : state.last)
+            live.emplace_back(it.second, it.first);
+        std::sort(live.begin(), live.end());
+
+        /* at least half the new timeline is free, so compactions stay rare */
+        size_t capacity = std::max<size_t>(64, 2 * live.size());
+        state.tree.assign(capacity + 1, 0);
+        uint32_t pos = 0;
+        for (auto& it : live) {
+            state.last[it.second] = ++pos;
+            state.tree[pos] = 1;
+        }
+        for (size_t i = 1; i <= capacity; i++) {
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= capacity)
+                state.tree[parent] += state.tree[i];
+        }
+        state.now = pos;
+    }
+
+    void StackDistance::access(uint64_t address) {
+        Addr addr = _at->translate(address);
+        SetState& state = _sets[addr.set];
+        uint64_t tag = addr.tag;
+
+        if (state.now + 1 >= state.tree.size())
+            compact(state);
+        uint32_t now = ++state.now;
+
+        auto it = state.last.find(tag);
+        if (it == state.last.end()) {
+            _cold++;
+            state.last.emplace(tag, now);
+        } else {
+            uint32_t distance = prefix(state.tree, now - 1) - prefix(state.tree, it->second);
+            if (distance < static_cast<uint32_t>(_max_ways))
+                _histogram[distance]++;
+            else
+                _far++;
+            add(state.tree, it->second, -1);
+            it->second = now;
+        }
+        add(state.tree, now, 1);
+    }
+
+    uint64_t StackDistance::references() const {
+        uint64_t total = _cold + _far;
+        for (auto count : _histogram)
+            total += count;
+        return total;
+    }
+
+    uint64_t StackDistance::hits(int ways) const {
+        uint64_t total = 0;
+        for (int d = 0; d < ways && d < _max_ways; d++)
+            total += _histogram[d];
+        return total;
+    }
+
+    void StackDistance::summary(std::ostream& out) const {
+        uint64_t refs = references();
+        out << "LRU stack distance summary:\n";
+        out << "  number of sets: " << _num_sets << "\n";
+        out << "  block size: " << _block_size << "B\n";
+        out << "  number of memory accesses: " << refs << "\n";
+        out << "  compulsory misses: " << _cold << "\n\n";
+
+        out << "  associativity  cache size (B)  hits  misses  hit rate  miss rate\n";
+        for (int ways = 1; ways <= _max_ways; ways *= 2) {
+            uint64_t h = hits(ways);
+            double hit_rate = refs == 0 ? 0.0 : (double) h / (double) refs;
+            double miss_rate = refs == 0 ? 0.0 : (double) (refs - h) / (double) refs;
+            out << "  " << ways << "  " << static_cast<uint64_t>(_block_size) * _num_sets * ways
+                << "  " << h << "  " << refs - h << "  " << hit_rate << "  " << miss_rate << "\n";
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * LRU stack distance analysis,
+ * one pass over a trace gives the hits and misses of an LRU cache at every associativity
+ */
+
+#ifndef CACHE_SIM_STACK_DISTANCE_HPP
+#define CACHE_SIM_STACK_DISTANCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "address_translator.hpp"
+#include "errors.hpp"
+
+namespace cs {
+
+/*
+ * Mattson stack distances per set
+ *
+ * a reference at distance d (number of distinct blocks of its set touched since its previous use)
+ * hits in every LRU cache with more than d ways and the same number of sets,
+ * so one histogram of distances covers every associativity and every cache size at this set count
+ *
+ * distances are counted with a Fenwick tree over each set's access timestamps,
+ * in which only the latest access to each block is marked
+ */
+    class StackDistance {
+        struct SetState {
+            std::unordered_map<uint64_t, uint32_t> last; /* block tag -> timestamp of its latest access */
+            std::vector<uint32_t> tree; /* Fenwick tree over timestamps 1 .. tree.size() - 1 */
+            uint32_t now;
+            SetState() : tree(65, 0), now(0) {}
+        };
+
+        AddressTranslator *_at;
+        size_t _block_size;
+        int _num_sets;
+        int _max_ways;
+        std::vector<SetState> _sets;
+        std::vector<uint64_t> _histogram; /* _histogram[d] references at distance d, d < _max_ways */
+        uint64_t _far; /* references at distance >= _max_ways */
+        uint64_t _cold; /* first references to a block */
+
+    public:
+    /*
+     * num_sets and block_size fix the set count and line size being analysed,
+     * distances are resolved up to max_ways
+     * throws AddressTranslation on inconsistent geometry
+     */
+        StackDistance(size_t block_size, int num_sets, int max_ways, unsigned address_size = 32);
+        ~StackDistance();
+
+        StackDistance(const StackDistance&) = delete;
+        StackDistance& operator=(const StackDistance&) = delete;
+
+        void access(uint64_t address);
+
+        uint64_t references() const;
+        uint64_t compulsory_misses() const { return _cold; }
+
+    /*
+     * hits of an LRU cache with `ways' lines per set, ways <= max_ways
+     */
+        uint64_t hits(int ways) const;
+
+    /*
+     * hits and misses for associativities 1, 2, 4 .. max_ways
+     */
+        void summary(std::ostream& out) const;
+
+    private:
+        static void add(std::vector<uint32_t>& tree, uint32_t pos, int32_t delta);
+        static uint32_t prefix(const std::vector<uint32_t>& tree, uint32_t pos);
+
+    /*
+     * renumbers the marked timestamps of a set to 1 .. k and makes room for more
+     */
+        static void compact(SetState& state);
+    };
+
+}
+
+#endif //CACHE_SIM_STACK_DISTANCE_HPP
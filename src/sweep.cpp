@@ -0,0 +1,214 @@
+/*
+ * Configuration sweep definition
+ */
+
+#include "sweep.hpp"
+#include <atomic>
+#include <utility>
+#include <thread>
+
+namespace cs {
+
+    /*
+     * splits s on sep
+     */
+    static std::vector<std::string> split(const std::string& s, char sep) {
+        std::vector<std::string> parts;
+        size_t begin = 0, end;
+        while ((end = s.find(sep, begin)) != std::string::npos) {
+            parts.push_back(s.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        parts.push_back(s.substr(begin));
+        return parts;
+    }
+
+    static std::vector<long> numbers(const std::string& field, const std::string& spec) {
+        std::vector<long> values;
+        for (auto& value : split(field, ',')) {
+            size_t used = 0;
+            long n = 0;
+            try {
+                n = std::stol(value, &used);
+            } catch (std::exception&) {
+                used = 0;
+            }
+            if (used == 0 || used != value.size() || n <= 0)
+                throw InvalidConfig("invalid sweep level -- " + spec);
+            values.push_back(n);
+        }
+        return values;
+    }
+
+    Sweep::Sweep(std::vector<std::vector<config>> hierarchies, int threads, std::vector<std::string> names)
+            : _hierarchies(std::move(hierarchies)), _results(_hierarchies.size()), _names(std::move(names)),
+              _threads(threads) {
+        if (_threads <= 0)
+            _threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (_threads <= 0)
+            _threads = 1;
+    }
+
+    std::vector<std::vector<config>> Sweep::grid(const std::vector<std::string>& levels) {
+        std::vector<std::vector<config>> hierarchies = {{}};
+
+        for (size_t l = 0; l < levels.size(); l++) {
+            std::vector<std::string> fields = split(levels[l], ':');
+            if (fields.size() < 4 || fields.size() > 6)
+                throw InvalidConfig("invalid sweep level -- expected size:block:associativity:write[:replacement[:inclusion]], got "
+                                    + levels[l]);
+
+            std::vector<long> sizes = numbers(fields[0], levels[l]);
+            std::vector<long> blocks = numbers(fields[1], levels[l]);
+            std::vector<long> assocs = numbers(fields[2], levels[l]);
+            std::vector<int> writes;
+            for (auto& write : split(fields[3], ',')) {
+                if (write == "wb")
+                    writes.push_back(write_back);
+                else if (write == "wt")
+                    writes.push_back(write_through);
+                else
+                    throw CSException("invalid sweep write policy -- wb | wt");
+            }
+            std::vector<std::string> replacements = fields.size() >= 5
+                    ? split(fields[4], ',') : std::vector<std::string>{"lru"};
+            std::vector<int> inclusions;
+            for (auto& inclusion : fields.size() == 6 ? split(fields[5], ',') : std::vector<std::string>{"nine"})
+                inclusions.push_back(inclusion_policy(inclusion));
+
+            std::vector<std::vector<config>> next;
+            for (auto& prefix : hierarchies) {
+                for (long size : sizes)
+                for (long block : blocks)
+                for (long assoc : assocs)
+                for (int write : writes)
+                for (auto& replacement : replacements)
+                for (int inclusion : inclusions) {
+                    config level = {l == 0 ? write : 0, write, static_cast<size_t>(size), static_cast<size_t>(block),
+                                    32, 1, 100, static_cast<int>(assoc), replacement, inclusion, false};
+                    next.push_back(prefix);
+                    next.back().push_back(level);
+                }
+            }
+            hierarchies.swap(next);
+        }
+        return hierarchies;
+    }
+
+    void Sweep::run(const Reference *refs, size_t count) {
+        std::atomic<size_t> next(0);
+
+        auto worker = [&]() {
+            for (size_t i; (i = next++) < _hierarchies.size(); ) {
+                SweepResult& result = _results[i];
+                try {
+                    std::vector<config> configs = _hierarchies[i];
+                    CacheDriver driver(configs);
+                    driver.classify(false); /* rows hold hits and misses only */
+                    (void) driver.exec(refs, count);
+
+                    for (auto cache : driver.caches()) {
+                        result.hits.push_back(static_cast<uint64_t>(cache->get_hits()));
+                        result.misses.push_back(static_cast<uint64_t>(cache->get_misses()));
+                    }
+                    result.amat = driver.AMAT();
+                } catch (std::exception& ex) {
+                    result.error = ex.what();
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        int threads = _threads < static_cast<int>(_hierarchies.size()) ? _threads : static_cast<int>(_hierarchies.size());
+        for (int t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool)
+            thread.join();
+    }
+
+    /*
+     * s as a CSV field, quoted with its quotes doubled when it holds a separator, a quote or a line break
+     */
+    static std::string csv_field(const std::string& s) {
+        if (s.find_first_of(",\"\r\n") == std::string::npos)
+            return s;
+        std::string quoted = "\"";
+        for (char c : s) {
+            if (c == '"')
+                quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    void Sweep::report(std::ostream& out) const {
+        size_t depth = 0;
+        for (auto& hierarchy : _hierarchies)
+            depth = hierarchy.size() > depth ? hierarchy.size() : depth;
+
+        /* a level gets instruction and data columns if any hierarchy splits it */
+        std::vector<bool> split_level(depth, false);
+        for (auto& hierarchy : _hierarchies) {
+            for (size_t l = 0; l < hierarchy.size(); l++) {
+                if (hierarchy[l].instruction != 0)
+                    split_level[l] = true;
+            }
+        }
+
+        out << "id";
+        for (size_t l = 1; l <= depth; l++) {
+            out << ",l" << l << "_size,l" << l << "_block,l" << l << "_assoc,l"
+                << l << "_write,l" << l << "_replacement,l" << l << "_inclusion";
+        }
+        for (size_t l = 1; l <= depth; l++) {
+            if (split_level[l - 1])
+                out << ",l" << l << "i_hits,l" << l << "i_misses,l" << l << "d_hits,l" << l << "d_misses";
+            else
+                out << ",l" << l << "_hits,l" << l << "_misses";
+        }
+        out << ",amat,error\n";
+
+        for (size_t i = 0; i < _hierarchies.size(); i++) {
+            const SweepResult& result = _results[i];
+            if (i < _names.size())
+                out << csv_field(_names[i]);
+            else
+                out << i;
+            for (size_t l = 0; l < depth; l++) {
+                if (l < _hierarchies[i].size()) {
+                    const config& level = _hierarchies[i][l];
+                    out << "," << level.total_size << "," << level.block_size << "," << level.blocks_per_set << ","
+                        << (level.data == write_back ? "wb" : "wt") << ","
+                        << (level.replacement.empty() ? "lru" : level.replacement) << ","
+                        << inclusion_name(level.inclusion);
+                } else {
+                    out << ",,,,,,";
+                }
+            }
+            /* results are in CacheDriver::caches() order, a unified cache goes in the data columns */
+            size_t c = 0;
+            for (size_t l = 0; l < depth; l++) {
+                bool simulated = l < _hierarchies[i].size() && c < result.hits.size();
+                if (split_level[l]) {
+                    if (simulated && _hierarchies[i][l].instruction != 0) {
+                        out << "," << result.hits[c] << "," << result.misses[c];
+                        c++;
+                    } else {
+                        out << ",,";
+                    }
+                }
+                if (simulated) {
+                    out << "," << result.hits[c] << "," << result.misses[c];
+                    c++;
+                } else {
+                    out << ",,";
+                }
+            }
+            if (result.error.empty())
+                out << "," << result.amat << ",\n";
+            else
+                out << ",," << csv_field(result.error) << "\n";
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Configuration sweep,
+ * simulates many hierarchies over one decoded trace on a pool of threads
+ */
+
+#ifndef CACHE_SIM_SWEEP_HPP
+#define CACHE_SIM_SWEEP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+#include "errors.hpp"
+#include "reference.hpp"
+
+namespace cs {
+
+/*
+ * result of one hierarchy of the sweep
+ */
+    struct SweepResult {
+        std::vector<uint64_t> hits, misses; /* per cache, in CacheDriver::caches() order */
+        double amat;
+        std::string error; /* set when the hierarchy couldn't be simulated */
+    };
+
+    class Sweep {
+        std::vector<std::vector<config>> _hierarchies;
+        std::vector<SweepResult> _results;
+        std::vector<std::string> _names;
+        int _threads;
+
+    public:
+    /*
+     * threads <= 0 uses every hardware thread,
+     * names label the report rows, which are numbered when there are none
+     */
+        Sweep(std::vector<std::vector<config>> hierarchies, int threads, std::vector<std::string> names = {});
+
+    /*
+     * builds the cartesian product of per-level grids,
+     * one spec per level: size:block:associativity:write[:replacement[:inclusion]]
+     * where every field is a comma separated list and write is wb or wt, e.g.
+     *   1024,2048:32:1,2,4:wb,wt
+     * throws InvalidConfig on malformed specs
+     */
+        static std::vector<std::vector<config>> grid(const std::vector<std::string>& levels);
+
+    /*
+     * runs a fresh CacheDriver per hierarchy over refs[0, count),
+     * the references are shared read-only by every worker
+     */
+        void run(const Reference *refs, size_t count);
+
+    /*
+     * one CSV row per hierarchy, with a header row
+     */
+        void report(std::ostream& out) const;
+
+        size_t size() const { return _hierarchies.size(); }
+    };
+
+}
+
+#endif //CACHE_SIM_SWEEP_HPP
@@ -0,0 +1,97 @@
+/*
+ * Tag matching kernels definition
+ */
+
+#include "tag_match.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace cs {
+
+    int match_tag_scalar(const uint64_t *tags, int ways, uint64_t tag) {
+        for (int way = 0; way < ways; way++) {
+            if (tags[way] == tag)
+                return way;
+        }
+        return -1;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+
+    /*
+     * SSE2 has no 64-bit compare, so compare 32-bit halves
+     * and keep the lanes where both halves matched
+     */
+    __attribute__((target("sse2")))
+    int match_tag_sse2(const uint64_t *tags, int ways, uint64_t tag) {
+        const __m128i probe = _mm_set1_epi64x(static_cast<long long>(tag));
+        int way = 0;
+        for (; way + 2 <= ways; way += 2) {
+            __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + way)), probe);
+            eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+            int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+            if (mask != 0)
+                return way + __builtin_ctz(mask);
+        }
+        for (; way < ways; way++) {
+            if (tags[way] == tag)
+                return way;
+        }
+        return -1;
+    }
+
+    __attribute__((target("avx2")))
+    int match_tag_avx2(const uint64_t *tags, int ways, uint64_t tag) {
+        const __m256i probe = _mm256_set1_epi64x(static_cast<long long>(tag));
+        int way = 0;
+        for (; way + 8 <= ways; way += 8) {
+            __m256i lo = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + way)), probe);
+            __m256i hi = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + way + 4)), probe);
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(lo)) | (_mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4);
+            if (mask != 0)
+                return way + __builtin_ctz(mask);
+        }
+        for (; way + 4 <= ways; way += 4) {
+            __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + way)), probe);
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+            if (mask != 0)
+                return way + __builtin_ctz(mask);
+        }
+        for (; way < ways; way++) {
+            if (tags[way] == tag)
+                return way;
+        }
+        return -1;
+    }
+
+    static tag_match_fn select_match_tag() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return match_tag_avx2;
+        if (__builtin_cpu_supports("sse2"))
+            return match_tag_sse2;
+        return match_tag_scalar;
+    }
+
+#else
+
+    static tag_match_fn select_match_tag() {
+        return match_tag_scalar;
+    }
+
+#endif
+
+    const tag_match_fn match_tag_best = select_match_tag();
+
+    const char *match_tag_name() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (match_tag_best == match_tag_avx2)
+            return "avx2";
+        if (match_tag_best == match_tag_sse2)
+            return "sse2";
+#endif
+        return "scalar";
+    }
+}
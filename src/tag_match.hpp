@@ -0,0 +1,40 @@
+/*
+ * Tag matching kernels,
+ * compare a probe tag against every tag of a set at once
+ */
+
+#ifndef CACHE_SIM_TAG_MATCH_HPP
+#define CACHE_SIM_TAG_MATCH_HPP
+
+#include <cstdint>
+
+namespace cs {
+
+/*
+ * a kernel returns the first way in tags[0, ways) holding tag, -1 if there is none
+ */
+    typedef int (*tag_match_fn)(const uint64_t *tags, int ways, uint64_t tag);
+
+    int match_tag_scalar(const uint64_t *tags, int ways, uint64_t tag);
+#if defined(__x86_64__) || defined(__i386__)
+    int match_tag_sse2(const uint64_t *tags, int ways, uint64_t tag);
+    int match_tag_avx2(const uint64_t *tags, int ways, uint64_t tag);
+#endif
+
+/*
+ * best kernel the running CPU supports, picked once at startup
+ */
+    extern const tag_match_fn match_tag_best;
+
+/*
+ * name of the kernel behind match_tag_best, "avx2", "sse2" or "scalar"
+ */
+    const char *match_tag_name();
+
+    inline int match_tag(const uint64_t *tags, int ways, uint64_t tag) {
+        return match_tag_best(tags, ways, tag);
+    }
+
+}
+
+#endif //CACHE_SIM_TAG_MATCH_HPP
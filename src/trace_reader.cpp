@@ -0,0 +1,153 @@
+/*
+ * Trace reader definition
+ */
+
+#include "trace_reader.hpp"
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cs {
+
+    static const size_t STREAM_CHUNK = 1 << 20;
+    static const size_t BATCH_SIZE = 4096;
+
+    /*
+     * true if the regular file at fd starts with the magic bytes of a compressed stream
+     */
+    static bool compressed(int fd) {
+        unsigned char magic[8];
+        ssize_t n = pread(fd, magic, sizeof(magic), 0);
+        return n > 0 && compression_of(magic, static_cast<size_t>(n)) != uncompressed;
+    }
+
+    TraceReader::TraceReader(const char *path)
+            : _fd(-1), _map(nullptr), _map_len(0), _stream(nullptr), _cur(nullptr), _end(nullptr), _eof(false), _line(0),
+              _batch(BATCH_SIZE) {
+
+        if (strcmp(path, "-") == 0) {
+            _fd = STDIN_FILENO;
+        } else {
+            _fd = ::open(path, O_RDONLY);
+            if (_fd < 0)
+                throw CSException("invalid input file");
+        }
+
+        struct stat st;
+        if (fstat(_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && !compressed(_fd)) {
+            void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (map != MAP_FAILED) {
+                _map = static_cast<char *>(map);
+                _map_len = st.st_size;
+                madvise(_map, _map_len, MADV_SEQUENTIAL);
+                _cur = _map;
+                _end = _map + _map_len;
+                _eof = true;
+                return;
+            }
+        }
+
+        /* not mappable or compressed -- fall back to buffered reads */
+        try {
+            _stream = InputStream::open(_fd);
+        } catch (...) {
+            if (_fd > STDIN_FILENO)
+                ::close(_fd);
+            throw;
+        }
+        _buf.resize(STREAM_CHUNK);
+        _cur = _end = _buf.data();
+    }
+
+    TraceReader::~TraceReader() {
+        delete _stream;
+        if (_map != nullptr)
+            munmap(_map, _map_len);
+        if (_fd > STDIN_FILENO)
+            ::close(_fd);
+    }
+
+    void TraceReader::refill() {
+        size_t left = _end - _cur;
+        if (left == _buf.size())
+            _buf.resize(_buf.size() * 2); /* a single line longer than the buffer */
+        memmove(_buf.data(), _cur, left);
+
+        size_t n = _stream->read(_buf.data() + left, _buf.size() - left);
+        if (n == 0)
+            _eof = true;
+
+        _cur = _buf.data();
+        _end = _cur + left + n;
+    }
+
+    bool TraceReader::next(Reference& ref) {
+        for (;;) {
+            const char *eol = _cur < _end
+                    ? static_cast<const char *>(memchr(_cur, '\n', _end - _cur)) : nullptr;
+            if (eol == nullptr) {
+                if (!_eof) {
+                    refill();
+                    continue;
+                }
+                if (_cur == _end)
+                    return false;
+                eol = _end; /* last line has no newline */
+            }
+
+            const char *begin = _cur;
+            _cur = eol == _end ? _end : eol + 1;
+            _line++;
+            if (parse(begin, eol, ref))
+                return true;
+        }
+    }
+
+    size_t TraceReader::next_batch(const Reference *&batch) {
+        size_t n = 0;
+        while (n < _batch.size() && next(_batch[n]))
+            n++;
+        batch = _batch.data();
+        return n;
+    }
+
+    bool TraceReader::parse(const char *begin, const char *end, Reference& ref) {
+        if (end > begin && end[-1] == '\r')
+            end--;
+
+        const char *space = static_cast<const char *>(memchr(begin, ' ', end - begin));
+        if (space == nullptr || space == begin || space + 1 == end)
+            throw InvalidLine(_line, std::string(begin, end));
+
+        if (space - begin != 1 || begin[0] < '0' || begin[0] > '2')
+            return false; /* not a reference type we simulate */
+        ref.type = begin[0] - '0';
+
+        const char *p = space + 1;
+        if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+            p += 2;
+        if (end - p > 16)
+            throw InvalidLine(_line, std::string(begin, end));
+
+        uint64_t address = 0;
+        for (; p < end; p++) {
+            char ch = *p;
+            uint64_t nibble;
+            if (ch >= '0' && ch <= '9')
+                nibble = ch - '0';
+            else if (ch >= 'a' && ch <= 'f')
+                nibble = ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F')
+                nibble = ch - 'A' + 10;
+            else
+                throw InvalidLine(_line, std::string(begin, end));
+            address = (address << 4) | nibble;
+        }
+        ref.address = address;
+        ref.reserved = 0;
+        return true;
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Trace reader,
+ * turns a text trace of `type hexaddr' lines into Reference records
+ */
+
+#ifndef CACHE_SIM_TRACE_READER_HPP
+#define CACHE_SIM_TRACE_READER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "errors.hpp"
+#include "input_stream.hpp"
+#include "reference.hpp"
+#include "trace_source.hpp"
+
+namespace cs {
+
+/*
+ * reads a trace without allocating per line
+ *
+ * regular files are memory mapped and parsed in place,
+ * pipes and other streams (or `-' for stdin) go through a reusable buffer,
+ * as do gzip, xz and zstd compressed traces, decompressed as they're read
+ */
+    class TraceReader : public TraceSource {
+        int _fd;
+        char *_map; /* mapped file, nullptr when streaming */
+        size_t _map_len;
+        InputStream *_stream; /* bytes of the trace when streaming */
+        std::vector<char> _buf; /* streaming buffer */
+        const char *_cur, *_end; /* unparsed bytes */
+        bool _eof; /* no more bytes beyond _end */
+        size_t _line;
+        std::vector<Reference> _batch; /* backing store for next_batch */
+
+    public:
+    /*
+     * opens the trace at path
+     * throws CSException when the file can't be opened
+     */
+        explicit TraceReader(const char *path);
+        ~TraceReader() override;
+
+        TraceReader(const TraceReader&) = delete;
+        TraceReader& operator=(const TraceReader&) = delete;
+
+    /*
+     * fills ref with the next reference,
+     * lines with an unknown type are skipped
+     * returns false at the end of the trace
+     * throws InvalidLine on malformed lines
+     */
+        bool next(Reference& ref);
+
+        size_t next_batch(const Reference *&batch) override;
+
+    /*
+     * number of the last line read
+     */
+        size_t line() const { return _line; }
+
+    private:
+    /*
+     * reads more of the stream into _buf, keeping the unparsed bytes
+     */
+        void refill();
+
+    /*
+     * parses the line [begin, end), returns false if it should be skipped
+     */
+        bool parse(const char *begin, const char *end, Reference& ref);
+    };
+
+}
+
+#endif //CACHE_SIM_TRACE_READER_HPP
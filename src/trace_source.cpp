@@ -0,0 +1,70 @@
+/*
+ * Trace source definition
+ */
+
+#include "trace_source.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include "binary_trace.hpp"
+#include "pipeline.hpp"
+#include "trace_reader.hpp"
+
+namespace cs {
+
+    /*
+     * text reader for path, on a reader thread if pipelined
+     */
+    static TraceSource *text(const char *path, bool pipelined) {
+        TraceSource *reader = new TraceReader(path);
+        return pipelined ? new PipelinedSource(reader) : reader;
+    }
+
+    TraceSource *TraceSource::open(const char *path, bool pipelined) {
+        /* pipes can't be peeked at without losing the bytes -- they're always text */
+        struct stat st;
+        if (strcmp(path, "-") == 0 || (stat(path, &st) == 0 && !S_ISREG(st.st_mode)))
+            return text(path, pipelined);
+
+        char magic[8];
+        size_t len;
+        std::FILE *file = std::fopen(path, "rb");
+        if (file == nullptr)
+            throw CSException("invalid input file");
+        len = std::fread(magic, 1, sizeof(magic), file);
+        std::fclose(file);
+
+        /* binary traces are mapped, there is nothing to overlap */
+        if (BinaryTrace::is_binary(magic, len))
+            return new BinaryTrace(path);
+        return text(path, pipelined);
+    }
+
+    DecodedTrace::DecodedTrace(const char *path) : DecodedTrace(TraceSource::open(path, true)) {}
+
+    DecodedTrace::DecodedTrace(TraceSource *source) : _source(source), _data(nullptr), _size(0) {
+        if (BinaryTrace *binary = dynamic_cast<BinaryTrace *>(_source)) {
+            _data = binary->data();
+            _size = binary->size();
+            return;
+        }
+
+        const Reference *batch;
+        size_t n;
+        try {
+            while ((n = _source->next_batch(batch)) != 0)
+                _refs.insert(_refs.end(), batch, batch + n);
+        } catch (...) {
+            delete _source;
+            throw;
+        }
+        delete _source;
+        _source = nullptr;
+        _data = _refs.data();
+        _size = _refs.size();
+    }
+
+    DecodedTrace::~DecodedTrace() {
+        delete _source;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Trace source,
+ * common interface of the trace readers the simulator can be fed from
+ */
+
+#ifndef CACHE_SIM_TRACE_SOURCE_HPP
+#define CACHE_SIM_TRACE_SOURCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "reference.hpp"
+
+namespace cs {
+
+    class TraceSource {
+    public:
+    /*
+     * points batch at the next run of references and returns how many there are,
+     * the run stays valid until the following call
+     * returns 0 at the end of the trace
+     */
+        virtual size_t next_batch(const Reference *&batch) = 0;
+        virtual ~TraceSource() = default;
+
+    /*
+     * moves past up to count references without decoding them, where the format allows it,
+     * returns how many it skipped -- 0 if it can't, the caller reads past them instead
+     */
+        virtual uint64_t seek(uint64_t count) { return 0; }
+
+    /*
+     * opens the trace at path (or `-' for stdin),
+     * picking the reader from the file's magic bytes
+     * pipelined traces that need decoding are read on a thread of their own, see PipelinedSource
+     * throws CSException when the file can't be opened
+     */
+        static TraceSource *open(const char *path, bool pipelined = false);
+    };
+
+/*
+ * a whole trace decoded into memory and shared read-only,
+ * binary traces are used in place from their mapping
+ */
+    class DecodedTrace {
+        TraceSource *_source;
+        std::vector<Reference> _refs;
+        const Reference *_data;
+        size_t _size;
+
+    public:
+    /*
+     * throws CSException when the trace can't be opened, InvalidLine on malformed lines
+     */
+        explicit DecodedTrace(const char *path);
+
+    /*
+     * decodes everything source yields, e.g. a Generator, taking ownership of it
+     */
+        explicit DecodedTrace(TraceSource *source);
+        ~DecodedTrace();
+
+        DecodedTrace(const DecodedTrace&) = delete;
+        DecodedTrace& operator=(const DecodedTrace&) = delete;
+
+        const Reference *data() const { return _data; }
+        size_t size() const { return _size; }
+    };
+
+}
+
+#endif //CACHE_SIM_TRACE_SOURCE_HPP
@@ -0,0 +1,93 @@
+/*
+ * Tracing definition
+ */
+
+#include "tracing.hpp"
+#include "reference.hpp"
+
+namespace cs {
+
+    static const char *const OPS[] = {"read", "write", "probe", "fill", "invalidate"};
+
+    TraceSink::TraceSink(std::ostream& out) : _out(out), _buf(BUFFER), _used(0) {
+        put("cache,op,address,set,tag,result,victim,writeback\n");
+    }
+
+    TraceSink::~TraceSink() {
+        flush();
+    }
+
+    void TraceSink::flush() {
+        _out.write(_buf.data(), static_cast<std::streamsize>(_used));
+        _out.flush();
+        _used = 0;
+    }
+
+    void TraceSink::put(char ch) {
+        if (_used == _buf.size())
+            flush();
+        _buf[_used++] = ch;
+    }
+
+    void TraceSink::put(const char *text) {
+        while (*text != '\0')
+            put(*text++);
+    }
+
+    void TraceSink::hex(uint64_t value) {
+        char digits[16];
+        int n = 0;
+        do {
+            digits[n++] = "0123456789abcdef"[value & 0xf];
+            value >>= 4;
+        } while (value != 0);
+        while (n > 0)
+            put(digits[--n]);
+    }
+
+    void TraceSink::dec(uint64_t value) {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (n > 0)
+            put(digits[--n]);
+    }
+
+    void TraceSink::emit(const TraceEvent& event) {
+        put(event.cache);
+        put(',');
+        put(OPS[event.op]);
+        put(',');
+        hex(event.address);
+        put(',');
+        dec(static_cast<uint64_t>(event.set));
+        put(',');
+        hex(event.tag);
+        put(event.hit ? ",hit," : ",miss,");
+        if (event.evicted) {
+            hex(event.victim);
+            put(event.writeback ? ",1\n" : ",0\n");
+        } else {
+            put(",\n");
+        }
+    }
+
+    void TraceSink::reference(int type, uint64_t address) {
+        switch (type) {
+            case DATA_READ:
+                put("trace,data_read,");
+                break;
+            case DATA_WRITE:
+                put("trace,data_write,");
+                break;
+            default:
+                put("trace,instruction_read,");
+                break;
+        }
+        hex(address);
+        put(",,,,,\n");
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Tracing,
+ * structured per-access events of the caches, compiled in with -DCACHE_SIM_TRACING=ON
+ */
+
+#ifndef CACHE_SIM_TRACING_HPP
+#define CACHE_SIM_TRACING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#ifndef CACHE_SIM_TRACING
+#define CACHE_SIM_TRACING 0
+#endif
+
+namespace cs {
+
+    /*
+     * true when tracing is built in,
+     * every trace point tests it first so a build without tracing drops them entirely
+     */
+    static constexpr bool TRACING = CACHE_SIM_TRACING != 0;
+
+    enum trace_op {
+        TRACE_READ,
+        TRACE_WRITE,
+        TRACE_PROBE, /* lookup without a fill, e.g. an exclusive level */
+        TRACE_FILL, /* block brought in without an access, e.g. a victim from above */
+        TRACE_INVALIDATE
+    };
+
+/*
+ * one access to one cache
+ */
+    struct TraceEvent {
+        const char *cache; /* name the cache was traced under */
+        int op; /* TRACE_ */
+        uint64_t address;
+        int set;
+        uint64_t tag;
+        bool hit;
+        bool evicted; /* victim holds the block address the access pushed out */
+        bool writeback; /* the victim was dirty */
+        uint64_t victim;
+    };
+
+/*
+ * buffered sink of trace events, written out as CSV lines
+ *   cache,op,address,set,tag,result,victim,writeback
+ * addresses and tags in hex, victim empty when nothing was evicted
+ * not thread safe, caches tracing into one sink must run on one thread
+ */
+    class TraceSink {
+        std::ostream& _out;
+        std::vector<char> _buf;
+        size_t _used;
+
+        void put(const char *text);
+        void put(char ch);
+        void hex(uint64_t value);
+        void dec(uint64_t value);
+
+    public:
+        static const size_t BUFFER = 1 << 16;
+
+        /* writes the header line */
+        explicit TraceSink(std::ostream& out);
+        ~TraceSink();
+
+        TraceSink(const TraceSink&) = delete;
+        TraceSink& operator=(const TraceSink&) = delete;
+
+        void emit(const TraceEvent& event);
+
+        /* a reference of the trace itself, logged ahead of the events it causes */
+        void reference(int type, uint64_t address);
+
+        void flush();
+    };
+
+}
+
+#endif //CACHE_SIM_TRACING_HPP
@@ -0,0 +1,115 @@
+/*
+ * Cache driver regression tests,
+ * run by ctest, each check prints what it found when it fails
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+
+namespace {
+
+    int failures = 0;
+
+    void expect(bool ok, const std::string& what) {
+        if (!ok) {
+            std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+            failures++;
+        }
+    }
+
+    /*
+     * count references of every type over a few hot and many cold blocks, from a fixed seed
+     */
+    std::vector<cs::Reference> trace(size_t count, uint64_t seed) {
+        std::vector<cs::Reference> refs(count);
+        uint64_t state = seed;
+        for (auto& ref : refs) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            uint64_t span = state % 4 == 0 ? 1 << 18 : 1 << 13;
+            ref.address = (state >> 8) % span;
+            ref.type = static_cast<int32_t>((state >> 40) % 3);
+            ref.reserved = 0;
+        }
+        return refs;
+    }
+
+    cs::config level(int instruction, size_t size, size_t block, int ways, int inclusion) {
+        return cs::config{instruction, cs::write_back, size, block, 32, 1, 100, ways, "lru", inclusion, false};
+    }
+
+    std::string counters(cs::Cache *cache) {
+        const cs::CacheStats& s = cache->stats();
+        return cache->name() + " hits " + std::to_string(s.hits) + " misses " + std::to_string(s.misses)
+               + " writebacks " + std::to_string(s.writebacks) + " compulsory " + std::to_string(s.compulsory)
+               + " capacity " + std::to_string(s.capacity) + " conflict " + std::to_string(s.conflict);
+    }
+
+    /*
+     * a batched exec, level by level with each level's writebacks staged between its misses,
+     * must leave every cache as a walk of the hierarchy reference by reference does
+     */
+    void batched_matches_per_reference(std::vector<cs::config> configs, const std::string& name) {
+        std::vector<cs::Reference> refs = trace(200000, 0x9e3779b97f4a7c15ull);
+        std::vector<cs::config> copy = configs;
+        cs::CacheDriver batched(configs), walked(copy);
+
+        (void) batched.exec(refs.data(), refs.size());
+        for (auto& ref : refs)
+            (void) walked.exec(ref.type, ref.address);
+
+        std::vector<cs::Cache *> a = batched.caches(), b = walked.caches();
+        for (size_t c = 0; c < a.size(); c++)
+            expect(counters(a[c]) == counters(b[c]), name + ": batched " + counters(a[c]) + ", per reference " + counters(b[c]));
+
+        /* and so must a partitioned run, but for the last level's three C's, which it doesn't classify */
+        copy = configs;
+        cs::CacheDriver partitioned(copy);
+        partitioned.exec_partitioned(refs.data(), refs.size(), 4);
+        std::vector<cs::Cache *> p = partitioned.caches();
+        for (size_t c = 0; c < p.size(); c++) {
+            const cs::CacheStats& x = p[c]->stats();
+            const cs::CacheStats& y = b[c]->stats();
+            expect(x.hits == y.hits && x.misses == y.misses && x.writebacks == y.writebacks,
+                   name + ": partitioned " + counters(p[c]) + ", per reference " + counters(b[c]));
+        }
+    }
+
+    /*
+     * a block dirty in a write-back L1 and clean in an inclusive L2 that evicts it
+     * is written back to L3 when the back-invalidation drops it from L1
+     */
+    void inclusive_eviction_writes_back_dirty_copies() {
+        std::vector<cs::config> configs = {level(0, 1024, 32, 2, cs::nine), level(0, 2048, 32, 1, cs::inclusive),
+                                           level(0, 16384, 32, 4, cs::nine)};
+        cs::CacheDriver driver(configs);
+        (void) driver.exec(cs::DATA_WRITE, 0); /* dirty in L1, fetched clean into L2 and L3 */
+        (void) driver.exec(cs::DATA_READ, 2048); /* same L2 line, evicts block 0 from it, and from L1 */
+
+        std::vector<cs::Cache *> caches = driver.caches();
+        const cs::CacheStats& l1 = caches[0]->stats();
+        const cs::CacheStats& l3 = caches[2]->stats();
+        expect(l1.writebacks == 1, "inclusive eviction: " + counters(caches[0]) + ", expected 1 writeback");
+        expect(l3.hits == 1 && l3.misses == 2, "inclusive eviction: " + counters(caches[2])
+                                               + ", expected block 0 written back to it as a hit");
+    }
+
+}
+
+int main() {
+    batched_matches_per_reference({level(cs::write_back, 1024, 32, 2, cs::nine), level(0, 4096, 32, 2, cs::nine),
+                                   level(0, 16384, 32, 4, cs::nine)}, "three write-back levels");
+    batched_matches_per_reference({level(cs::write_back, 1024, 32, 2, cs::nine), level(0, 4096, 32, 2, cs::nine),
+                                   level(0, 8192, 32, 2, cs::nine), level(0, 32768, 64, 8, cs::nine)},
+                                  "four write-back levels");
+    inclusive_eviction_writes_back_dirty_copies();
+
+    if (failures != 0)
+        std::fprintf(stderr, "%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}